@@ -0,0 +1,154 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "json.hpp"
+#include "validatorUtils.hpp"
+
+using json = nlohmann::json;
+
+// Messages in the generated answer: about 5 MB.
+#define kMessages 20000
+
+/*
+ An answer shaped like those of the Nu Html Checker (out=json): compact, fields in its order,
+ info messages with a subType, some without a firstLine or a firstColumn, extracts with escaped
+ quotes and line breaks, and non-ASCII messages.
+ */
+static std::string generateAnswer()
+{
+    std::string answer = "{\"url\":\"file.html\",\"messages\":[";
+    
+    for (size_t i = 0; i < kMessages; ++i)
+    {
+        auto line = std::to_string(i + 10);
+        
+        answer += i > 0 ? "," : "";
+        answer += i % 3 == 0 ? "{\"type\":\"error\"," : "{\"type\":\"info\",\"subType\":\"warning\",";
+        answer += i % 5 == 0 ? "" : "\"firstLine\":" + std::to_string(i + 9) + ",";
+        answer += "\"lastLine\":" + line + ",\"lastColumn\":42,";
+        answer += i % 7 == 0 ? "" : "\"firstColumn\":3,";
+        answer += "\"message\":\"Element “div” not allowed as child of element “span” in this context.\",";
+        answer += "\"extract\":\"<span class=\\\"label\\\"><div id=\\\"item-" + line + "\\\">\\n  text\",";
+        answer += "\"hiliteStart\":10,\"hiliteLength\":20}";
+    }
+    
+    return answer + "],\"language\":\"en\"}";
+}
+
+/*
+ The former parseResponse: a json DOM, then a lookup per field.
+ */
+static bool parseWithDocument(const std::string &response, std::vector<problem_t> &problems)
+{
+    json result;
+    
+    try
+    {
+        result = json::parse(response);
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    
+    for (auto &message : result["messages"])
+    {
+        problem_t problem;
+        problem.type = message.count("type") > 0 ? message["type"].get<std::string>() : "unknown";
+        problem.message = message.count("message") > 0 ? message["message"].get<std::string>() : "No message";
+        problem.extract = message.count("extract") > 0 ? message["extract"].get<std::string>() : "No extract";
+        problem.lastLine = message.count("lastLine") > 0 ? message["lastLine"].get<ssize_t>() : -1;
+        problem.lastColumn = message.count("lastColumn") > 0 ? message["lastColumn"].get<ssize_t>() : -1;
+        problem.firstLine = message.count("firstLine") > 0 ? message["firstLine"].get<ssize_t>() : problem.lastLine;
+        problem.firstColumn = message.count("firstColumn") > 0 ? message["firstColumn"].get<ssize_t>() : problem.lastColumn;
+        problems.push_back(problem);
+    }
+    
+    return true;
+}
+
+/*
+ Parses a recorded answer if one is given (e.g. saved from curl -F out=json), a generated
+ one otherwise.
+ */
+int main(int argc, char **argv)
+{
+    std::string response = generateAnswer();
+    
+    if (argc > 1)
+    {
+        std::ifstream file(argv[1]);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        response = contents.str();
+    }
+
+    size_t repetitions = 20;
+    std::vector<problem_t> documentProblems, streamProblems;
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    for (size_t i = 0; i < repetitions; ++i)
+    {
+        documentProblems.clear();
+        parseWithDocument(response, documentProblems);
+    }
+    
+    auto middle = std::chrono::steady_clock::now();
+    
+    for (size_t i = 0; i < repetitions; ++i)
+    {
+        streamProblems.clear();
+        validatorUtils::parseResponse(response, streamProblems);
+    }
+    
+    auto end = std::chrono::steady_clock::now();
+    
+    bool identical = documentProblems.size() == streamProblems.size();
+    
+    for (size_t i = 0; identical && i < streamProblems.size(); ++i)
+    {
+        auto &a = documentProblems[i], &b = streamProblems[i];
+        identical = a.type == b.type && a.message == b.message && a.extract == b.extract &&
+                    a.firstLine == b.firstLine && a.firstColumn == b.firstColumn &&
+                    a.lastLine == b.lastLine && a.lastColumn == b.lastColumn;
+    }
+    
+    std::cout << response.length() / 1024 << " KB, " << streamProblems.size() << " messages: json DOM "
+              << std::chrono::duration<double, std::milli>(middle - start).count() / repetitions << " ms, stream "
+              << std::chrono::duration<double, std::milli>(end - middle).count() / repetitions << " ms, "
+              << (identical ? "identical problems" : "DIFFERENT problems") << std::endl;
+    
+    return identical ? 0 : 1;
+}
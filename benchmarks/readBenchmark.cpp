@@ -0,0 +1,93 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "fileUtils.hpp"
+#include "hashUtils.hpp"
+#include "stringUtils.hpp"
+
+/*
+ Reads, hashes and normalizes files of growing sizes, as the read stage does, through
+ istreambuf_iterator (the former way) and through fileUtils::fileBuffer.
+ */
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "readBenchmark.html";
+    std::string line = "<div class=\"x\">    <a href=\"a.html\">link</a>    </div>\n";
+    size_t sizes[] = {1 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20, 8 << 20};
+    uint64_t checksum = 0;
+    
+    for (auto size : sizes)
+    {
+        {
+            std::ofstream file(path);
+            
+            for (size_t written = 0; written < size; written += line.length())
+            {
+                file << line;
+            }
+        }
+        
+        // About 64 MB read per measure, whatever the size.
+        size_t repetitions = std::max<size_t>(3, (64 << 20) / size);
+        
+        auto start = std::chrono::steady_clock::now();
+        
+        for (size_t i = 0; i < repetitions; ++i)
+        {
+            std::ifstream file(path);
+            std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            checksum += hashUtils::hash64(text);
+            stringUtils::trim(text);
+            checksum += text.length();
+        }
+        
+        auto middle = std::chrono::steady_clock::now();
+        
+        for (size_t i = 0; i < repetitions; ++i)
+        {
+            fileUtils::fileBuffer file(path);
+            checksum += hashUtils::hash64(file.data(), file.size());
+            checksum += stringUtils::trimmed(file.data(), file.size()).length();
+        }
+        
+        auto end = std::chrono::steady_clock::now();
+        
+        std::cout << size / 1024 << " KB: istreambuf "
+                  << std::chrono::duration<double, std::micro>(middle - start).count() / repetitions << " us, fileBuffer "
+                  << std::chrono::duration<double, std::micro>(end - middle).count() / repetitions << " us" << std::endl;
+    }
+    
+    std::remove(path.c_str());
+    
+    return checksum == 0;
+}
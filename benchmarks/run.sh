@@ -0,0 +1,88 @@
+#!/bin/bash
+#
+# Builds and runs the benchmarks quoted in the history, from a scratch directory:
+#   benchmarks/run.sh [read] [parse] [spawn] [uring] [search]
+# With no argument, all of them are run. "search" times a whole offline search of a
+# generated tree of 2000 pages: run it from two checkouts to compare them. "parse" times
+# the answer recorded at the absolute path in $NU_ANSWER, if set, instead of a generated one.
+#
+
+set -e
+
+repository="$(cd "$(dirname "$0")/.." && pwd)"
+scratch="$(mktemp -d)"
+trap 'rm -rf "$scratch"' EXIT
+
+benchmarks="${*:-read parse spawn uring search}"
+# Some sources rely on headers included by others, as the platform toolchains allow.
+flags="-std=c++14 -O2 -pthread -I$repository -I$repository/utils -include algorithm -include mutex -include iostream"
+
+# The utilities are compiled once, in parallel, for all benchmarks.
+compileUtilities()
+{
+    echo "building the utilities..." >&2
+    
+    for source in "$repository"/utils/*.cpp
+    do
+        g++ $flags -c "$source" -o "$scratch/$(basename "${source%.cpp}").o" &
+    done
+    
+    wait
+}
+
+build()
+{
+    echo "building $(basename "$1")..." >&2
+    g++ $flags "$1" "$scratch"/*Utils.o -o "$2"
+}
+
+# 20 directories of 100 pages of about 64 KB, each with 60 links to the next one.
+generateTree()
+{
+    local text="$(for i in $(seq 1 36); do printf 'lorem ipsum dolor sit amet '; done)"
+    local body="$(for i in $(seq 1 60); do printf '<p>%s<a href="next.html">next</a></p>' "$text"; done)"
+    
+    for d in $(seq 0 19)
+    do
+        mkdir -p "$1/d$d"
+        
+        for p in $(seq 0 99)
+        do
+            printf '<!DOCTYPE html><html lang="en"><head><meta name="author" content="a"><title>t</title></head><body>%s</body></html>\n' \
+                "${body//next.html/p$(( (p + 1) % 100 )).html}" > "$1/d$d/p$p.html"
+        done
+    done
+}
+
+cd "$scratch"
+compileUtilities
+
+for benchmark in $benchmarks
+do
+    case "$benchmark" in
+        read)
+            build "$repository/benchmarks/readBenchmark.cpp" readBenchmark && ./readBenchmark ;;
+        parse)
+            build "$repository/benchmarks/parseBenchmark.cpp" parseBenchmark && ./parseBenchmark ${NU_ANSWER:+"$NU_ANSWER"} ;;
+        spawn)
+            build "$repository/benchmarks/spawnBenchmark.cpp" spawnBenchmark && ./spawnBenchmark ;;
+        uring)
+            build "$repository/benchmarks/uringBenchmark.cpp" uringBenchmark
+            mkdir -p files
+            for i in $(seq 0 19999); do echo "<p>$i</p>" > "files/$i.html"; done
+            ls -d "$PWD"/files/* > files.txt
+            ./uringBenchmark files.txt ;;
+        search)
+            mkdir -p tree
+            build "$repository/main.cpp" tree/htmlvalidator
+            generateTree tree
+            # The first search warms the page cache and fills the persistent cache: clear it.
+            printf -- '--validator=offline\n\nexit\n' | ./tree/htmlvalidator > /dev/null 2>&1
+            rm -f tree/.htmlvalidator-*.json
+            TIMEFORMAT="search of 2000 pages: %R s"
+            time (printf -- '--validator=offline\n\nexit\n' | ./tree/htmlvalidator > /dev/null 2>&1) ;;
+        *)
+            echo "unknown benchmark: $benchmark" >&2
+            exit 1 ;;
+    esac
+done
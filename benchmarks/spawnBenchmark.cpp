@@ -0,0 +1,105 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "shellUtils.hpp"
+
+// Programs started per measure.
+#define kSpawns 500
+
+/*
+ Starts programs and reads their output through popen (the former way) and shellUtils::run.
+ */
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "spawnBenchmark.bin";
+    processOptions_t options = {true, false, 0};
+    size_t checksum = 0;
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    for (size_t i = 0; i < kSpawns; ++i)
+    {
+        checksum += pclose(popen("true", "r")) == 0;
+    }
+    
+    auto popenEnd = std::chrono::steady_clock::now();
+    
+    for (size_t i = 0; i < kSpawns; ++i)
+    {
+        checksum += shellUtils::run({"/bin/sh", "-c", "true"}, nullptr, 0, options).exitStatus == 0;
+    }
+    
+    auto shellEnd = std::chrono::steady_clock::now();
+    
+    for (size_t i = 0; i < kSpawns; ++i)
+    {
+        checksum += shellUtils::run({"true"}, nullptr, 0, options).exitStatus == 0;
+    }
+    
+    auto end = std::chrono::steady_clock::now();
+    
+    std::cout << "spawn: popen " << std::chrono::duration<double, std::micro>(popenEnd - start).count() / kSpawns
+              << " us, run via sh " << std::chrono::duration<double, std::micro>(shellEnd - popenEnd).count() / kSpawns
+              << " us, run with argv " << std::chrono::duration<double, std::micro>(end - shellEnd).count() / kSpawns
+              << " us" << std::endl;
+    
+    // 50 MB of output, as fgets with a 128-byte buffer used to read it.
+    shellUtils::run({"/bin/sh", "-c", "head -c 52428800 /dev/urandom > '" + path + "'"}, nullptr, 0, options);
+    
+    start = std::chrono::steady_clock::now();
+    
+    std::string output;
+    char buffer[128];
+    FILE *pipe = popen(("cat '" + path + "'").c_str(), "r");
+    
+    while (fgets(buffer, sizeof(buffer), pipe))
+    {
+        output += buffer;
+    }
+    
+    pclose(pipe);
+    
+    auto middle = std::chrono::steady_clock::now();
+    
+    auto result = shellUtils::run({"cat", path}, nullptr, 0, options);
+    
+    end = std::chrono::steady_clock::now();
+    
+    std::cout << "read 50 MB: popen " << std::chrono::duration<double>(middle - start).count()
+              << " s (" << output.length() << " bytes kept), run " << std::chrono::duration<double>(end - middle).count()
+              << " s (" << result.output.length() << " bytes kept)" << std::endl;
+    
+    std::remove(path.c_str());
+    
+    return checksum == 0;
+}
@@ -0,0 +1,98 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "uringUtils.hpp"
+
+// Files read ahead per batch, as the read stage does.
+#define kBatchSize 64
+
+/*
+ Looks up and reads the files listed, one per line, in the given file, with system calls
+ and with io_uring.
+ */
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <file listing the paths>" << std::endl;
+        return 1;
+    }
+    
+    std::vector<std::string> paths;
+    std::ifstream list(argv[1]);
+    std::string line;
+    
+    while (std::getline(list, line))
+    {
+        paths.push_back(line);
+    }
+    
+    size_t checksum = 0;
+    
+    // The first round warms the page cache.
+    for (size_t round = 0; round < 2; ++round)
+    {
+        for (auto enabled : {false, true})
+        {
+            uringUtils::setEnabled(enabled);
+            
+            auto start = std::chrono::steady_clock::now();
+            checksum += uringUtils::getFileSignatures(paths).size();
+            auto middle = std::chrono::steady_clock::now();
+            
+            for (size_t first = 0; first < paths.size(); first += kBatchSize)
+            {
+                std::vector<std::string> batch(paths.begin() + first, paths.begin() + std::min(paths.size(), first + kBatchSize));
+                auto files = uringUtils::readFiles(batch);
+                
+                for (size_t i = 0; i < batch.size(); ++i)
+                {
+                    // Files the ring could not read are read synchronously, as the read stage does.
+                    checksum += files[i] ? files[i]->size() : fileUtils::fileBuffer(batch[i]).size();
+                }
+            }
+            
+            auto end = std::chrono::steady_clock::now();
+            
+            if (round > 0)
+            {
+                std::cout << (enabled ? "io_uring" : "sync    ") << ": stat "
+                          << (size_t)(paths.size() / std::chrono::duration<double>(middle - start).count()) << " files/s, read "
+                          << (size_t)(paths.size() / std::chrono::duration<double>(end - middle).count()) << " files/s" << std::endl;
+            }
+        }
+    }
+    
+    return checksum == 0;
+}
@@ -31,27 +31,245 @@
  - validator.w3.org will ban your ip if you run this program too often
  */
 
-#include <fstream>
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <thread>
 #include <unistd.h>
 #include <vector>
 
+#include "cacheUtils.hpp"
+#include "cancelUtils.hpp"
 #include "curlUtils.hpp"
+#include "documentCacheUtils.hpp"
 #include "fileUtils.hpp"
+#include "gitUtils.hpp"
+#include "hashUtils.hpp"
+#include "healthUtils.hpp"
+#include "indexUtils.hpp"
+#include "ledgerUtils.hpp"
+#include "pipelineUtils.hpp"
 #include "shellUtils.hpp"
 #include "stringUtils.hpp"
+#include "threadUtils.hpp"
+#include "uringUtils.hpp"
 #include "urlUtils.hpp"
+#include "validatorUtils.hpp"
+#include "walkUtils.hpp"
 
-#define kValidatorWebsite "https://validator.w3.org/"
+#define kValidatorWebsite "https://validator.w3.org/nu/"
+
+// Validation results, keyed by content hash. Lives next to the executable, can be shared across machines.
+#define kCacheFile ".htmlvalidator-cache.json"
+
+// Requests sent to each validator, for --budget. Lives next to the cache.
+#define kLedgerFile ".htmlvalidator-ledger.json"
+
+// Queued documents between two stages of the search pipeline.
+#define kPipelineQueueSize 64
+
+// Changed files read ahead at once by discovery, see uringUtils::readFiles.
+#define kReadAheadBatchSize 64
+
+// Documents validated at once for each network slot (--io-jobs): they spend most of their
+// time waiting for links and for the validator.
+#define kValidationsPerNetworkSlot 4
+
+// Memory kept for the documents of the last searches, see --cache-memory.
+#define kDocumentCacheMegabytes 256
+
+// With --watch, how long files must stay unchanged before they are validated again.
+#define kWatchQuietSeconds 0.2
 
 typedef std::map<std::string, int> statistics_t;
 //typedef std::map<std::string, statistics_t> groupStatistics_t;
 
-typedef std::map<std::string, document_t> documentsMap_t;
+// Checked documents are immutable, and shared by the cache and the search results.
+typedef std::map<std::string, documentPtr_t> documentsMap_t;
+
+typedef std::vector<documentPtr_t> documentsVector_t;
+
+/*
+ A document going through the search pipeline.
+ */
+struct pipelineItem_t
+{
+    std::string path;
+    std::string signature; // See fileUtils::getFileSignature
+    std::unique_ptr<fileUtils::fileBuffer> file; // Read ahead by discovery, if at all
+    document_t document; // While it is being checked
+    documentPtr_t result; // Once checked, or served from the document cache
+    bool validated; // Rather than served from the document cache
+};
+
+typedef std::shared_ptr<pipelineItem_t> pipelineItemPtr_t;
+
+/*
+ @brief: remove every occurrence of the reserved keyword `name` from `args`, either alone
+        (`--name`) or with a value (`--name=value`).
+ 
+ @param `args` The keywords entered by the user.
+ @param `name` The reserved keyword to look for.
+ @param `value` Set to the value of the last occurrence, if any.
+ 
+ @return bool. Whether the keyword was found.
+ */
+static bool extractOption(std::vector<std::string> &args, const std::string &name, std::string &value)
+{
+    bool found = false;
+    
+    for (auto it = args.begin(); it != args.end();)
+    {
+        if (it->compare(name) == 0)
+        {
+            found = true;
+            it = args.erase(it);
+        }
+        else if (it->compare(0, name.length() + 1, name + "=") == 0)
+        {
+            found = true;
+            value = it->substr(name.length() + 1);
+            it = args.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    
+    return found;
+}
+
+static void cancelOnInterrupt(int)
+{
+    cancelUtils::cancel();
+}
+
+/*
+ @brief: return whether the validation of a document ended, i.e. it has no timeout, deferred
+        or unavailable problem. Only complete results are cached.
+ 
+ @param `document` A validated document.
+ 
+ @return bool.
+ */
+static bool isComplete(const document_t &document)
+{
+    return std::none_of(document.problems.begin(), document.problems.end(), [](const problem_t &problem) {
+        return problem.type.compare("timeout") == 0 || problem.type.compare("deferred") == 0 || problem.type.compare("unavailable") == 0;
+    });
+}
+
+/*
+ @brief: freeze a checked document into the result shared by the search results and the
+        document cache. Its text and tree are dropped: the cache accounts for them apart.
+ 
+ @param `document` The checked document, moved from.
+ 
+ @return documentPtr_t.
+ */
+static documentPtr_t makeResult(document_t &&document)
+{
+    document.plaintext.reset();
+    document.file.reset();
+    document.tree.reset();
+    
+    return std::make_shared<const document_t>(std::move(document));
+}
+
+/*
+ @brief: write the cache and the request ledger, reporting failures.
+ 
+ @return void.
+ */
+static void saveCaches()
+{
+    if (!cacheUtils::save(kCacheFile))
+    {
+        shellUtils::setColor(shellTextColor::FG_RED);
+        std::cout << std::endl << "Unable to write the cache to " << kCacheFile << std::endl;
+        shellUtils::resetColor();
+    }
+    
+    if (!ledgerUtils::save(kLedgerFile))
+    {
+        shellUtils::setColor(shellTextColor::FG_RED);
+        std::cout << std::endl << "Unable to write the request ledger to " << kLedgerFile << std::endl;
+        shellUtils::resetColor();
+    }
+}
 
-typedef std::vector<document_t> documentsVector_t;
+/*
+ @brief: print a document and its problems, counting them in `aggregatedData`.
+ 
+ @param `path` The path to the document.
+ @param `document` The validated document.
+ @param `aggregatedData` Counts of pages and problems by type.
+ 
+ @return void.
+ */
+static void printDocument(const std::string &path, const document_t &document, std::map<std::string, ssize_t> &aggregatedData)
+{
+    std::cout << std::endl;
+    std::cout << path << std::endl;
+    std::cout << "Author: " << document.author << std::endl;
+    
+    ++aggregatedData["pages"];
+    if (document.problems.size() > 0)
+    {
+        for (auto &problem : document.problems)
+        {
+            ++aggregatedData[problem.type + "s"];
+            
+            if (problem.type.compare("error") == 0)
+            {
+                shellUtils::setColor(shellTextColor::FG_RED);
+            }
+            else if (problem.type.compare("info") == 0)
+            {
+                shellUtils::setColor(shellTextColor::FG_YELLOW);
+            }
+            else if (problem.type.compare("non-document-error") == 0)
+            {
+                shellUtils::setColor(shellTextColor::FG_CYAN);
+            }
+            else if (problem.type.compare("timeout") == 0 || problem.type.compare("unavailable") == 0)
+            {
+                shellUtils::setColor(shellTextColor::FG_MAGENTA);
+            }
+            else if (problem.type.compare("deferred") == 0)
+            {
+                shellUtils::setColor(shellTextColor::FG_DARK_GRAY);
+            }
+            
+            std::cout << "\tType: " << problem.type << std::endl;
+            shellUtils::resetColor();
+            std::cout << "\tMessage: " << problem.message << std::endl;
+            std::cout << "\tExtract: ";
+            
+            shellUtils::setColor(shellTextColor::FG_BLUE);
+            std::cout << problem.extract << std::endl;
+            shellUtils::resetColor();
+            
+            std::cout << "\tLine: " << problem.firstLine << std::endl;
+            //std::cout << "\tFirst column: " << problem.firstColumn << std::endl;
+            //std::cout << "\tLast line: " << problem.lastLine << std::endl;
+            //std::cout << "\tLast column: " << problem.lastColumn << std::endl;
+            std::cout << std::endl;
+        }
+    }
+    else
+    {
+        shellUtils::setColor(shellTextColor::FG_GREEN);
+        std::cout << "No problems found" << std::endl;
+        shellUtils::resetColor();
+    }
+}
 
 int main(int argc, const char * argv[])
 {
@@ -63,12 +281,37 @@ int main(int argc, const char * argv[])
     
     shellUtils::clear();
     
-    documentsMap_t documentsCache;
+    documentCacheUtils::documentCache documentCache((size_t)kDocumentCacheMegabytes << 20);
+    
+    cacheUtils::load(kCacheFile);
+    ledgerUtils::load(kLedgerFile);
+    
+    // Patterns use .gitignore syntax, see globUtils. Exclusions add up to the defaults.
+    walkOptions_t defaultWalkOptions;
+    defaultWalkOptions.includePatterns = {"*.html"};
+    defaultWalkOptions.excludePatterns = {"*template*", ".git/"};
+    defaultWalkOptions.ignoreFiles = {".gitignore", ".validatorignore"};
     
-    std::map<std::string, std::string> readCache;
+    // Searches start from the index, kept up to date while the user is typing.
+    indexUtils::start(".", defaultWalkOptions);
+    
+    // The validator of the last search, most likely the one of the next. Empty until a
+    // search used one: the program starts without any network request.
+    std::string lastEndpoint;
+    
+    // Kept from one search to the next, so that it keeps what it learned about its service
+    // (e.g. its capacity): only made again when its options change.
+    std::shared_ptr<validatorUtils::validatorBackend> backend;
+    std::string backendOptions;
     
     while (true)
     {
+        // Check its health while the user is typing.
+        if (lastEndpoint.length() > 0)
+        {
+            healthUtils::monitor(lastEndpoint).refresh();
+        }
+        
         shellUtils::clear();
         shellUtils::setColor(shellTextColor::FG_DARK_GRAY);
         std::cout << "HTML Validator v1.2.3 (November 10, 2016)" << std::endl;
@@ -80,7 +323,23 @@ int main(int argc, const char * argv[])
         std::cout << std::endl;
         std::cout << "Specifying no keyword will result in all documents being displayed." << std::endl;
         std::cout << "Reserved keywords:" << std::endl;
-        //std::cout << " - --force-update: will force the program to reload all cached files" << std::endl;
+        std::cout << " - --force-update: will force the program to validate all documents again, ignoring cached results." << std::endl;
+        std::cout << " - --timeout=<seconds>: maximum duration of each network request (default: 60)." << std::endl;
+        std::cout << " - --connect-timeout=<seconds>: maximum time to connect to a host (default: 10)." << std::endl;
+        std::cout << " - --deadline=<seconds>: maximum duration of the whole validation. Ctrl-C also stops it early." << std::endl;
+        std::cout << " - --jobs=<count>: number of documents validated in parallel (default: one per core)." << std::endl;
+        std::cout << " - --io-jobs=<count>: maximum number of concurrent network requests (default: 16)." << std::endl;
+        std::cout << " - --validator=<url>|offline: Nu Html Checker compatible service to use (default: " kValidatorWebsite "), or offline embedded rules." << std::endl;
+        std::cout << " - --hedge=<url>: second validator, also sent the documents the first one is slow to answer." << std::endl;
+        std::cout << " - --gzip: compress big documents sent to the validator, to cut upload time." << std::endl;
+        std::cout << " - --budget=<requests>: maximum number of requests sent to the validator per window. Documents over budget are deferred to a later run." << std::endl;
+        std::cout << " - --budget-window=<hours>: length of the rolling budget window (default: 24)." << std::endl;
+        std::cout << " - --include=<glob>[,<glob>...]: documents to validate (default: *.html)." << std::endl;
+        std::cout << " - --exclude=<glob>[,<glob>...]: files and directories to skip, as in .gitignore (default: *template*, .git/). A leading ! validates them again." << std::endl;
+        std::cout << " - --watch: after the search, validate documents again as they are saved, until Ctrl-C." << std::endl;
+        std::cout << " - --git-changes[=<revision>|<from>..<to>]: only validate the documents changed in git, and those linking to them (default: working tree against HEAD)." << std::endl;
+        std::cout << " - --io-uring: batch the system calls looking up and reading files through io_uring, where the kernel supports it." << std::endl;
+        std::cout << " - --cache-memory=<megabytes>: memory kept for documents between searches (default: " << kDocumentCacheMegabytes << ")." << std::endl;
         std::cout << " - exit: will terminate this program." << std::endl;
         std::cout << std::endl;
         shellUtils::resetColor();
@@ -93,234 +352,650 @@ int main(int argc, const char * argv[])
         // caused all results to be displayed
         stringUtils::trim(userInput);
         
-        std::transform(userInput.begin(), userInput.end(), userInput.begin(), ::tolower);
-        
         // Exit if requested.
-        if (userInput.compare("exit") == 0)
+        if (stringUtils::lowercase(userInput).compare("exit") == 0)
         {
             break;
         }
         
-        if (curlUtils::getWebsiteState(kValidatorWebsite).find("403") != std::string::npos)
+        auto args = stringUtils::tokenize(userInput, ' ');
+        
+        // Reserved keywords are extracted before lowercasing, since their values may be case sensitive.
+        std::string optionValue;
+        
+        if (extractOption(args, "--force-update", optionValue))
         {
-            shellUtils::setColor(shellTextColor::FG_RED);
-            std::cout << "Too many files sent to: https://validator.w3.org/. Please try again later." << std::endl;
-            shellUtils::waitForInput("exit");
-            break;
+            documentCache.clearResults();
+            cacheUtils::clear();
         }
-        else if (!curlUtils::isWebsiteOk(kValidatorWebsite))
+        
+        double connectTimeout = 10;
+        double totalTimeout = 60;
+        double deadline = 0;
+        
+        if (extractOption(args, "--connect-timeout", optionValue))
         {
-            shellUtils::setColor(shellTextColor::FG_RED);
-            std::cout << "https://validator.w3.org/ unreachable. Please try again later." << std::endl;
-            shellUtils::waitForInput("exit");
-            break;
+            connectTimeout = std::atof(optionValue.c_str());
+        }
+        
+        if (extractOption(args, "--timeout", optionValue))
+        {
+            totalTimeout = std::atof(optionValue.c_str());
+        }
+        
+        if (extractOption(args, "--deadline", optionValue))
+        {
+            deadline = std::atof(optionValue.c_str());
+        }
+        
+        size_t jobs = 0;
+        size_t ioJobs = 16;
+        
+        if (extractOption(args, "--jobs", optionValue))
+        {
+            jobs = std::max(0, std::atoi(optionValue.c_str()));
+        }
+        
+        if (extractOption(args, "--io-jobs", optionValue))
+        {
+            ioJobs = std::max(1, std::atoi(optionValue.c_str()));
+        }
+        
+        std::string validator = kValidatorWebsite;
+        
+        if (extractOption(args, "--validator", optionValue))
+        {
+            validator = optionValue;
+        }
+        
+        bool budgeted = false;
+        size_t budget = 0;
+        double budgetWindow = 24;
+        
+        if (extractOption(args, "--budget", optionValue))
+        {
+            budgeted = true;
+            budget = std::max(0, std::atoi(optionValue.c_str()));
+        }
+        
+        if (extractOption(args, "--budget-window", optionValue))
+        {
+            budgetWindow = std::atof(optionValue.c_str());
+        }
+        
+        bool compress = extractOption(args, "--gzip", optionValue);
+        
+        std::string hedgeValidator;
+        
+        if (extractOption(args, "--hedge", optionValue))
+        {
+            hedgeValidator = optionValue;
         }
-
-        auto args = stringUtils::tokenize(userInput, ' ');
         
-        for (auto it = args.begin(); it < args.end(); ++it)
+        auto walkOptions = defaultWalkOptions;
+        
+        if (extractOption(args, "--include", optionValue))
         {
-            if ((*it).compare("--force-update") == 0)
+            walkOptions.includePatterns = stringUtils::tokenize(optionValue, ',');
+        }
+        
+        if (extractOption(args, "--exclude", optionValue))
+        {
+            for (auto &pattern : stringUtils::tokenize(optionValue, ','))
             {
-                args.erase(it);
-                documentsCache.clear();
+                walkOptions.excludePatterns.push_back(pattern);
             }
         }
         
+        bool watch = extractOption(args, "--watch", optionValue);
         
+        size_t cacheMegabytes = kDocumentCacheMegabytes;
         
-        /*
-         1. Prepare documents to validate
-         */
+        if (extractOption(args, "--cache-memory", optionValue))
+        {
+            cacheMegabytes = std::max(0, std::atoi(optionValue.c_str()));
+        }
         
-        std::cout << "Looking for changes in the directory tree..." << std::endl;
+        documentCache.setBudget(cacheMegabytes << 20);
         
-        // Load a list of all html files, ignoring templates.
-        auto paths = stringUtils::tokenize(shellUtils::exec("find . -print | grep \".html$\" | grep -v \"template\""), '\n');
+        uringUtils::setEnabled(extractOption(args, "--io-uring", optionValue));
         
-        if (paths.size() > 0 && paths.back().compare("") == 0)
+        std::string gitRevisions;
+        
+        optionValue = "HEAD";
+        if (extractOption(args, "--git-changes", optionValue))
         {
-            //Erase empty last line.
-            paths.pop_back();
+            gitRevisions = optionValue;
         }
         
-        documentsMap_t searchResults;
+        auto options = validator + (compress ? " --gzip " : " ") + hedgeValidator;
         
-        // Prepare a document per path
-        for (ssize_t i = 0; i < paths.size(); ++i)
+        if (!backend || options.compare(backendOptions) != 0)
         {
-            auto &path = paths[i];
-            std::cout << "\r" << "Preparing file: " << i + 1 << "/" << paths.size() << std::flush;
+            backend = validatorUtils::makeBackend(validator, compress, hedgeValidator);
+            backendOptions = options;
             
-            document_t document;
+            // Results kept in memory come from the former backend.
+            documentCache.clearResults();
+        }
+        else
+        {
+            // Statistics are printed per search.
+            backend->resetStatistics();
+        }
+        
+        validatorUtils::setBackend(backend);
+        
+        curlUtils::setTimeouts(connectTimeout, totalTimeout);
+        // Kept across searches, like the backend, unless --jobs or --io-jobs change.
+        threadUtils::configure(jobs, ioJobs);
+        cancelUtils::reset();
+        
+        for (auto &arg : args)
+        {
+            arg = stringUtils::lowercase(arg);
+        }
+        
+        // Offline backends have no endpoint to check. Remote ones check it before their
+        // first request: see validatorUtils::remoteValidator.
+        if (backend->endpoint().length() > 0)
+        {
+            lastEndpoint = backend->endpoint();
+        }
+        
+        
+        /*
+         1. Discover documents
+         */
+        
+        std::cout << "Looking for changes in the directory tree..." << std::endl;
+        
+        documentsMap_t searchResults;
+        
+        std::mutex preparationMutex;
+        
+        // Read stage: contents come from the document cache while the file is unchanged.
+        // Return false if the file could not be read, e.g. because it was removed since discovery.
+        auto readDocument = [&](pipelineItem_t &item) {
+            auto &document = item.document;
+            documentContents_t contents;
             
             //TODO: document_t could be a class itself...
-            if (readCache.count(path) > 0)
+            // Bug fix: edited files used to be served from readCache forever.
+            // Documents to be sent are read anyway, so that the bytes sent are those hashed.
+            if (documentCache.lookupContents(item.path, item.signature, contents) && !validatorUtils::needsFile(contents.contentHash))
             {
-                document.plaintext = readCache[path];
+                document.plaintext = contents.plaintext;
+                document.contentHash = contents.contentHash;
+                document.tree = contents.tree;
+                return true;
             }
-            else
+            
+            // Read at once, without stream buffers: the bytes are only kept while they may be sent.
+            if (!item.file)
             {
-                // Source on reading files: http://stackoverflow.com/questions/2912520/read-file-contents-into-a-string-in-c
-                std::ifstream ifs(path);
-                std::string htmlText((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
-                ifs.close();
-                stringUtils::trim(htmlText);
-                
-                document.plaintext = htmlText;
-                
-                readCache[path] = document.plaintext;
+                item.file.reset(new fileUtils::fileBuffer(item.path));
+            }
+            
+            auto &file = *item.file;
+            
+            if (!file.isValid())
+            {
+                item.file.reset();
+                return false;
             }
             
+            // Hash the file as it is sent to the validator, before normalization.
+            document.contentHash = hashUtils::hash64(file.data(), file.size());
+            
             //Ensure white-spaces normalization
+            document.plaintext = std::make_shared<const std::string>(stringUtils::trimmed(file.data(), file.size()));
             
-            document.tree = htmlUtils::parseHtmlText(document.plaintext);
+            if (validatorUtils::needsFile(document.contentHash))
+            {
+                document.file = std::move(item.file);
+            }
             
-            document.author = htmlUtils::getMetaAuthor(document.tree);
+            item.file.reset();
             
-            std::string authorLowercase = stringUtils::lowercase(document.author);
-            std::string pathLowercase = stringUtils::lowercase(path);
+            contents.plaintext = document.plaintext;
+            contents.contentHash = document.contentHash;
+            documentCache.storeContents(item.path, item.signature, contents);
             
-            bool matches = false;
+            return true;
+        };
+        
+        // Parse stage: return whether the document matches the keywords.
+        auto parseDocument = [&](pipelineItem_t &item) {
+            auto &document = item.document;
+            
+            // Trees evicted from the cache are parsed again.
+            if (!document.tree)
+            {
+                document.tree = std::make_shared<const elementsTree_t>(htmlUtils::parseHtmlText(*document.plaintext));
+                documentCache.storeTree(item.path, item.signature, document.tree);
+            }
+            
+            document.author = htmlUtils::getMetaAuthor(*document.tree);
+            
+            std::string authorLowercase = stringUtils::lowercase(document.author);
+            std::string pathLowercase = stringUtils::lowercase(item.path);
             
             for (auto &arg : args)
             {
                 if (authorLowercase.find(arg) != std::string::npos ||
                     pathLowercase.find(arg) != std::string::npos)
                 {
-                    matches = true;
-                    break;
+                    return true;
                 }
             }
             
-            if (matches || args.size() == 0)
+            return args.size() == 0;
+        };
+        
+        // Single documents, for --watch: those matching the keywords are added to `documents`.
+        auto prepareDocument = [&](const std::string &path, std::map<std::string, document_t> &documents) {
+            pipelineItem_t item;
+            item.path = path;
+            item.signature = fileUtils::getFileSignature(path);
+            
+            if (readDocument(item) && parseDocument(item))
             {
-                searchResults[path] = document;
+                std::lock_guard<std::mutex> lock(preparationMutex);
+                documents[path] = std::move(item.document);
             }
-        }
-        
-        std::cout << std::endl;
-        
+        };
         
-        /*
-         2. Load cache
-         */
+        // All html files, ignoring templates and what the ignore files list.
+        auto paths = indexUtils::snapshot(walkOptions);
+        std::vector<std::string> treePaths;
         
-        documentsMap_t uncachedDocuments;
-        
-        ssize_t i = 0;
-        for (auto &searchResult : searchResults)
+        // In incremental mode, changed documents and those linking to them (as of their last
+        // validation) are the only ones read: the others keep their results.
+        if (gitRevisions.length() > 0)
         {
-            ++i;
-            std::cout << "\r" << "Loading cache: " << i << "/" << searchResults.size() << std::flush;
-            if (documentsCache.count(searchResult.first) > 0)
+            std::set<std::string> gitChangedFiles;
+            
+            if (!gitUtils::getChangedFiles(gitRevisions, gitChangedFiles))
             {
-                searchResult.second = documentsCache[searchResult.first];
+                shellUtils::setColor(shellTextColor::FG_RED);
+                std::cout << "Unable to list the files changed in git (" << gitRevisions << ")." << std::endl;
+                shellUtils::resetColor();
+                shellUtils::waitForInput("start new search");
+                continue;
             }
-            else
+            
+            std::set<std::string> selectedPaths;
+            
+            for (auto &changedFile : gitChangedFiles)
             {
-                // TODO: find less expensive way to do this list of uncached files...
-                uncachedDocuments[searchResult.first] = searchResult.second;
+                auto referrers = cacheUtils::getReferrers(changedFile);
+                selectedPaths.insert(changedFile);
+                selectedPaths.insert(referrers.begin(), referrers.end());
             }
+            
+            treePaths.swap(paths);
+            std::set_intersection(treePaths.begin(), treePaths.end(), selectedPaths.begin(), selectedPaths.end(), std::back_inserter(paths));
         }
         
-        std::cout << std::endl;
-        
+        // Documents created or edited since the last search, read ahead.
+        std::set<std::string> changedFiles;
+        auto signatures = uringUtils::getFileSignatures(paths);
         
-        /*
-         3. Validate documents
-         */
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            if (!documentCache.hasSignature(paths[i], signatures[i]))
+            {
+                changedFiles.insert(paths[i]);
+            }
+        }
         
-        // TODO: check if load failures are common
-        std::vector<std::thread>threads;
+        // A file of the last search missing from the tree was deleted.
+        auto &allPaths = gitRevisions.length() > 0 ? treePaths : paths;
+        std::set<std::string> currentPaths(allPaths.begin(), allPaths.end());
         
-        for (auto &uncachedEntry : uncachedDocuments)
+        for (auto &path : documentCache.paths())
         {
-            threads.push_back(std::thread(&htmlUtils::validateHtml, uncachedEntry.first, executablePath, std::ref(uncachedEntry.second)));
+            if (currentPaths.count(path) == 0)
+            {
+                documentCache.erase(path);
+                cacheUtils::setLinks(path, {});
+            }
         }
         
-        for (auto &thread : threads)
+        // Or of an earlier run.
+        for (auto &path : cacheUtils::getDocuments())
         {
-            thread.join();
+            if (currentPaths.count(path) == 0)
+            {
+                cacheUtils::eraseDocument(path);
+                cacheUtils::setLinks(path, {});
+            }
         }
         
+        // Links to the files of the tree are checked without looking them up again.
+        urlUtils::setKnownFiles(executablePath, allPaths);
         
+        // Files created, edited or deleted since the documents linking to them were checked,
+        // documents or not, by this process or an earlier one: the reverse link graph is kept
+        // with the cache (see htmlUtils::validateHtml). Their referrers' results are dropped,
+        // so that those left out of this search are checked again by the next one.
+        std::set<std::string> affectedPaths;
+        auto linkedFiles = cacheUtils::getLinkedFiles();
+        auto linkedSignatures = uringUtils::getFileSignatures(linkedFiles);
         
-        /*
-         4. Update cache
-         */
-        ssize_t writingToCache = 0;
-        for (auto &newlyCachedEntry : uncachedDocuments)
+        for (size_t i = 0; i < linkedFiles.size(); ++i)
         {
-            ++writingToCache;
+            std::string signature;
             
-            std::cout << "\r" << "Writing to cache: " << writingToCache << "/" << uncachedDocuments.size() << std::flush;
+            if (cacheUtils::getSignature(linkedFiles[i], signature) && signature.compare(linkedSignatures[i]) == 0)
+            {
+                continue;
+            }
             
-            searchResults[newlyCachedEntry.first] = newlyCachedEntry.second;
-            documentsCache[newlyCachedEntry.first] = newlyCachedEntry.second;
+            auto referrers = cacheUtils::getReferrers(linkedFiles[i]);
+            affectedPaths.insert(referrers.begin(), referrers.end());
+            cacheUtils::setSignature(linkedFiles[i], linkedSignatures[i]);
         }
         
+        for (auto &path : affectedPaths)
+        {
+            documentCache.eraseResult(path);
+            cacheUtils::eraseDocument(path);
+        }
         
         
         /*
-         5. Output data
+         2. Check documents, as a pipeline: read -> parse and filter -> look up in the cache ->
+            validate (local checks and validator) -> report. Stages overlap, and bounded queues
+            keep at most a few hundred documents in memory between them.
          */
         
-        std::map<std::string, ssize_t> aggregatedData;
+        // Only services which need the network have a quota to preserve.
+        budgeted = budgeted && backend->endpoint().length() > 0;
         
-        shellUtils::clear();
+        size_t budgetUsed = budgeted ? ledgerUtils::countRequests(backend->endpoint(), budgetWindow * 3600) : 0;
+        ledgerUtils::clearBudgets();
+        auto previouslyDeferred = ledgerUtils::deferredPaths(backend->endpoint());
+        std::set<std::string> deferredPaths;
+        
+        // One request per distinct content missing from the persistent cache.
+        std::map<uint64_t, budgetCandidate_t> candidates;
+        
+        // The deadline covers checks only: discovery is local and bounded.
+        cancelUtils::setDeadline(deadline);
+        auto previousInterruptHandler = std::signal(SIGINT, cancelOnInterrupt);
+        
+        std::vector<std::pair<std::string, stageStatistics_t>> pipelineStatistics;
         
-        //Display results
-        for (auto &cacheEntry : searchResults)
         {
-            std::cout << std::endl;
-            std::cout << cacheEntry.first << std::endl;
-            std::cout << "Author: " << cacheEntry.second.author << std::endl;
+            auto &pool = threadUtils::sharedPool();
+            size_t workers = pool.statistics().threads;
             
-            ++aggregatedData["pages"];
-            if (cacheEntry.second.problems.size() > 0)
-            {
-                for (auto &problem : cacheEntry.second.problems)
+            // Documents until they are reported or filtered out, and until they are looked up.
+            threadUtils::taskGroup documents(pool);
+            threadUtils::taskGroup lookups(pool);
+            
+            std::mutex resultsMutex;
+            size_t checkedCount = 0;
+            
+            typedef pipelineUtils::stage<pipelineItemPtr_t> stage_t;
+            
+            // A single consumer, which owns the results.
+            stage_t reportStage(pool, kPipelineQueueSize, 1, [&](pipelineItemPtr_t &item) {
+                auto &path = item->path;
+                
+                if (!item->result)
                 {
-                    ++aggregatedData[problem.type + "s"];
-                    
-                    if (problem.type.compare("error") == 0)
+                    item->result = makeResult(std::move(item->document));
+                }
+                
+                auto &problems = item->result->problems;
+                
+                std::lock_guard<std::mutex> lock(resultsMutex);
+                
+                if (item->validated)
+                {
+                    // Incomplete results must be checked again by the next search.
+                    if (isComplete(*item->result))
                     {
-                        shellUtils::setColor(shellTextColor::FG_RED);
+                        documentCache.storeResult(path, item->result);
+                        cacheUtils::storeDocument(path, cacheUtils::makeKey(backend->name(), item->result->contentHash), problems);
+                        
+                        bool erroring = std::any_of(problems.begin(), problems.end(), [](const problem_t &problem) {
+                            return problem.type.compare("error") == 0;
+                        });
+                        
+                        ledgerUtils::setErroring(path, erroring);
                     }
-                    else if (problem.type.compare("info") == 0)
+                    
+                    bool deferred = std::any_of(problems.begin(), problems.end(), [](const problem_t &problem) {
+                        return problem.type.compare("deferred") == 0;
+                    });
+                    
+                    if (deferred)
                     {
-                        shellUtils::setColor(shellTextColor::FG_YELLOW);
+                        deferredPaths.insert(path);
                     }
-                    else if (problem.type.compare("non-document-error") == 0)
+                    
+                    previouslyDeferred.erase(path);
+                }
+                
+                searchResults[path] = std::move(item->result);
+                
+                std::cout << "\r" << "Checking documents: " << ++checkedCount << std::flush;
+                
+                documents.done();
+                return true;
+            });
+            
+            // TODO: check if load failures are common
+            // Validations complete asynchronously: links and requests wait on the I/O pool.
+            stage_t validateStage(pool, kPipelineQueueSize, ioJobs * kValidationsPerNetworkSlot, [&](pipelineItemPtr_t &item) {
+                item->validated = true;
+                
+                htmlUtils::validateHtml(item->path, executablePath, item->document, [item, &validateStage, &reportStage]() {
+                    validateStage.finish();
+                    reportStage.push(item);
+                });
+                
+                return false;
+            });
+            
+            stage_t lookupStage(pool, kPipelineQueueSize, workers, [&](pipelineItemPtr_t &item) {
+                auto &path = item->path;
+                
+                // Results of a previous version of the document are stale. Those of documents
+                // linking to changed files were dropped before the search.
+                auto contentHash = item->document.contentHash;
+                bool cached = documentCache.lookupResult(path, contentHash, item->result);
+                
+                std::vector<problem_t> cachedProblems;
+                
+                // Complete results of an earlier run, if the document did not change since.
+                if (!cached && cacheUtils::lookupDocument(path, cacheUtils::makeKey(backend->name(), contentHash), item->document.problems))
+                {
+                    item->result = makeResult(std::move(item->document));
+                    documentCache.storeResult(path, item->result);
+                    cached = true;
+                }
+                
+                if (!cached && budgeted && !cacheUtils::lookup(cacheUtils::makeKey(backend->name(), contentHash), cachedProblems))
+                {
+                    auto erroring = ledgerUtils::wasErroring(path);
+                    auto modificationTime = fileUtils::getModificationTime(path);
+                    
+                    std::lock_guard<std::mutex> lock(resultsMutex);
+                    
+                    auto &candidate = candidates[contentHash];
+                    candidate.contentHash = contentHash;
+                    candidate.previouslyErroring = candidate.previouslyErroring || erroring;
+                    candidate.previouslyDeferred = candidate.previouslyDeferred || previouslyDeferred.count(path) > 0;
+                    candidate.modificationTime = std::max(candidate.modificationTime, modificationTime);
+                }
+                
+                (cached ? reportStage : validateStage).push(item);
+                lookups.done();
+                
+                return true;
+            });
+            
+            stage_t parseStage(pool, kPipelineQueueSize, workers, [&](pipelineItemPtr_t &item) {
+                if (parseDocument(*item))
+                {
+                    lookupStage.push(item);
+                }
+                else
+                {
+                    lookups.done();
+                    documents.done();
+                }
+                
+                return true;
+            });
+            
+            stage_t readStage(pool, kPipelineQueueSize, workers, [&](pipelineItemPtr_t &item) {
+                // Files removed since discovery are left out, as if they had not been found.
+                if (readDocument(*item))
+                {
+                    parseStage.push(item);
+                }
+                else
+                {
+                    lookups.done();
+                    documents.done();
+                }
+                
+                return true;
+            });
+            
+            readStage.addOutput(parseStage);
+            parseStage.addOutput(lookupStage);
+            lookupStage.addOutput(validateStage);
+            lookupStage.addOutput(reportStage);
+            validateStage.addOutput(reportStage);
+            
+            // The request budget is shared out once every document missing from the cache is known.
+            if (budgeted)
+            {
+                validateStage.hold();
+            }
+            
+            // Discovery, on this thread: it waits whenever the readers fall behind. Changed files
+            // are read ahead in batches, the others are most likely in the document cache.
+            for (size_t begin = 0; begin < paths.size(); begin += kReadAheadBatchSize)
+            {
+                size_t end = std::min(paths.size(), begin + kReadAheadBatchSize);
+                std::vector<std::string> readAheadPaths;
+                
+                for (size_t i = begin; i < end; ++i)
+                {
+                    if (changedFiles.count(paths[i]) > 0)
                     {
-                        shellUtils::setColor(shellTextColor::FG_CYAN);
+                        readAheadPaths.push_back(paths[i]);
                     }
+                }
+                
+                auto files = uringUtils::readFiles(readAheadPaths);
+                size_t fileIdx = 0;
+                
+                for (size_t i = begin; i < end; ++i)
+                {
+                    auto item = std::make_shared<pipelineItem_t>();
+                    item->path = paths[i];
+                    item->signature = signatures[i];
+                    item->validated = false;
                     
-                    std::cout << "\tType: " << problem.type << std::endl;
-                    shellUtils::resetColor();
-                    std::cout << "\tMessage: " << problem.message << std::endl;
-                    std::cout << "\tExtract: ";
-                    
-                    shellUtils::setColor(shellTextColor::FG_BLUE);
-                    std::cout << problem.extract << std::endl;
-                    shellUtils::resetColor();
+                    if (changedFiles.count(paths[i]) > 0)
+                    {
+                        item->file = std::move(files[fileIdx++]);
+                    }
                     
-                    std::cout << "\tLine: " << problem.firstLine << std::endl;
-                    //std::cout << "\tFirst column: " << problem.firstColumn << std::endl;
-                    //std::cout << "\tLast line: " << problem.lastLine << std::endl;
-                    //std::cout << "\tLast column: " << problem.lastColumn << std::endl;
-                    std::cout << std::endl;
+                    documents.add();
+                    lookups.add();
+                    readStage.pushWaiting(item);
                 }
             }
-            else
+            
+            if (budgeted)
             {
-                shellUtils::setColor(shellTextColor::FG_GREEN);
-                std::cout << "No problems found" << std::endl;
-                shellUtils::resetColor();
+                lookups.wait();
+                
+                std::vector<budgetCandidate_t> candidatesVector;
+                
+                for (auto &candidate : candidates)
+                {
+                    candidatesVector.push_back(candidate.second);
+                }
+                
+                auto available = budget > budgetUsed ? budget - budgetUsed : 0;
+                auto deferredHashes = ledgerUtils::selectDeferred(candidatesVector, available);
+                
+                // Retries, hedges and re-sends only get what the documents sent leave.
+                ledgerUtils::setBudget(backend->endpoint(), budget, budgetWindow * 3600, candidatesVector.size() - deferredHashes.size());
+                
+                if (hedgeValidator.length() > 0)
+                {
+                    ledgerUtils::setBudget(hedgeValidator, budget, budgetWindow * 3600, 0);
+                }
+                
+                validatorUtils::setDeferred(deferredHashes);
+                validateStage.release();
+            }
+            
+            documents.wait();
+            
+            // Every stage must be idle before any is destroyed.
+            stage_t *stages[] = {&readStage, &parseStage, &lookupStage, &validateStage, &reportStage};
+            const char *stageNames[] = {"read", "parse", "lookup", "validate", "report"};
+            
+            for (size_t i = 0; i < 5; ++i)
+            {
+                stages[i]->waitIdle();
+            }
+            
+            for (size_t i = 0; i < 5; ++i)
+            {
+                pipelineStatistics.push_back(std::make_pair(stageNames[i], stages[i]->statistics()));
             }
         }
         
+        std::cout << std::endl;
+        
+        std::signal(SIGINT, previousInterruptHandler);
+        
+        
+        
+        /*
+         3. Update cache
+         */
+        
+        // Paths deferred earlier but not part of this search stay deferred. Offline backends
+        // send no request, so the ledger has nothing to record for them.
+        if (backend->endpoint().length() > 0)
+        {
+            deferredPaths.insert(previouslyDeferred.begin(), previouslyDeferred.end());
+            ledgerUtils::setDeferredPaths(backend->endpoint(), deferredPaths);
+        }
+        
+        saveCaches();
+        
+        
+        
+        /*
+         4. Output data
+         */
+        
+        std::map<std::string, ssize_t> aggregatedData;
+        
+        shellUtils::clear();
+        
+        //Display results
+        for (auto &cacheEntry : searchResults)
+        {
+            printDocument(cacheEntry.first, *cacheEntry.second, aggregatedData);
+        }
+        
         // Output aggregated statistics.
         std::cout << std::endl;
         if (aggregatedData.size() > 0)
@@ -338,8 +1013,304 @@ int main(int argc, const char * argv[])
         
         std::cout << std::endl;
         
+        // Output executor statistics.
+        auto poolStatistics = threadUtils::sharedPool().statistics();
+        auto ioStatistics = threadUtils::ioPool().statistics();
+        
+        std::cout << "Executor:" << std::endl;
+        std::cout << "\tworkers: " << poolStatistics.threads << ", tasks: " << poolStatistics.executed << ", stolen: " << poolStatistics.stolen << ", peak queue depth: " << poolStatistics.peakQueued << std::endl;
+        std::cout << "\tnetwork slots: " << ioStatistics.threads << ", requests: " << ioStatistics.executed << ", peak queue depth: " << ioStatistics.peakQueued << std::endl;
+        std::cout << std::endl;
+        
+        // Output pipeline statistics.
+        std::cout << "Pipeline:" << std::endl;
+        
+        for (auto &stageStatistics : pipelineStatistics)
+        {
+            auto &statistics = stageStatistics.second;
+            
+            std::cout << "\t" << stageStatistics.first << ": " << statistics.processed << " documents";
+            std::cout << ", peak occupancy: " << statistics.peakOccupancy << " (queue capacity " << statistics.capacity << ")";
+            std::cout << ", mean occupancy: " << statistics.averageOccupancy << ", producer waits: " << statistics.producerWaits << std::endl;
+        }
+        std::cout << std::endl;
+        
+        // Output document cache statistics.
+        auto cacheStatistics = documentCache.statistics();
+        
+        std::cout << "Document cache:" << std::endl;
+        std::cout << "\tdocuments: " << cacheStatistics.documents << ", memory: " << (cacheStatistics.bytes >> 10) << " KB";
+        std::cout << " (budget " << (cacheStatistics.budget >> 10) << " KB, peak " << (cacheStatistics.peakBytes >> 10) << " KB)" << std::endl;
+        std::cout << "\ttexts: " << cacheStatistics.textHits << " hits, " << cacheStatistics.textMisses << " misses, " << cacheStatistics.textEvictions << " evicted" << std::endl;
+        std::cout << "\ttrees: " << cacheStatistics.treeHits << " hits, " << cacheStatistics.treeMisses << " misses, " << cacheStatistics.treeEvictions << " evicted" << std::endl;
+        std::cout << "\tresults: " << cacheStatistics.resultHits << " hits, " << cacheStatistics.resultMisses << " misses, " << cacheStatistics.resultEvictions << " evicted" << std::endl;
+        std::cout << std::endl;
+        
+        // Output file index statistics.
+        auto indexStatistics = indexUtils::statistics();
+        
+        std::cout << "File index:" << std::endl;
+        std::cout << "\tfiles: " << indexStatistics.files << ", full walks: " << indexStatistics.rebuilds;
+        
+        if (indexStatistics.watching)
+        {
+            std::cout << ", watched directories: " << indexStatistics.directories << ", changes applied: " << indexStatistics.events << std::endl;
+        }
+        else
+        {
+            std::cout << " (changes not watched, walked for every search)" << std::endl;
+        }
+        std::cout << std::endl;
+        
+        // Output file I/O statistics.
+        auto uringStatistics = uringUtils::statistics();
+        
+        std::cout << "File I/O:" << std::endl;
+        
+        if (uringStatistics.available && uringStatistics.enabled)
+        {
+            std::cout << "\tio_uring submissions: " << uringStatistics.submissions << ", operations: " << uringStatistics.operations;
+            std::cout << ", synchronous fallbacks: " << uringStatistics.fallbacks << std::endl;
+        }
+        else
+        {
+            std::cout << "\tsynchronous" << (uringStatistics.enabled ? " (io_uring unavailable)" : "") << std::endl;
+        }
+        
+        auto existenceStatistics = urlUtils::existenceStatistics();
+        std::cout << "\tlocal link targets looked up: " << existenceStatistics.lookups << ", with a system call: " << existenceStatistics.systemCalls << std::endl;
+        std::cout << std::endl;
+        
+        // Output validator statistics.
+        auto dedupStatistics = validatorUtils::dedupStatistics();
+        
+        if (dedupStatistics.documents > 0)
+        {
+            std::cout << "Validator requests:" << std::endl;
+            std::cout << "\tdocuments: " << dedupStatistics.documents << ", sent: " << dedupStatistics.sent;
+            std::cout << ", cached: " << dedupStatistics.cached << ", identical to another document: " << dedupStatistics.coalesced << std::endl;
+            if (dedupStatistics.deferred > 0)
+            {
+                std::cout << "\tdeferred by the request budget: " << dedupStatistics.deferred << std::endl;
+            }
+            
+            std::cout << "\tdedup ratio: " << (double)(dedupStatistics.documents - dedupStatistics.deferred) / std::max<size_t>(dedupStatistics.sent, 1) << " documents per request" << std::endl;
+            std::cout << std::endl;
+        }
+        
+        if (budgeted)
+        {
+            std::cout << "Request budget:" << std::endl;
+            std::cout << "\tused: " << ledgerUtils::countRequests(backend->endpoint(), budgetWindow * 3600) << "/" << budget << " in the last " << budgetWindow << " hours";
+            std::cout << ", documents deferred: " << deferredPaths.size() << std::endl;
+            std::cout << std::endl;
+        }
+        
+        auto validatorStatistics = backend->statistics();
+        
+        if (validatorStatistics.requests > 0)
+        {
+            std::cout << "Validator (" << backend->name() << "):" << std::endl;
+            std::cout << "\tdocuments: " << validatorStatistics.requests << ", failures: " << validatorStatistics.failures << ", bytes: " << validatorStatistics.bytesSent << std::endl;
+            std::cout << "\tthroughput: " << validatorStatistics.requests / std::max(validatorStatistics.elapsed, 0.001) << " documents/s";
+            std::cout << ", mean latency: " << validatorStatistics.totalLatency / validatorStatistics.requests << " s";
+            std::cout << ", max latency: " << validatorStatistics.maxLatency << " s" << std::endl;
+            std::cout << "\tlatency p50: " << validatorStatistics.p50Latency << " s, p95: " << validatorStatistics.p95Latency << " s, p99: " << validatorStatistics.p99Latency << " s" << std::endl;
+            
+            if (validatorStatistics.retries > 0 || validatorStatistics.hedged > 0)
+            {
+                std::cout << "\tretries: " << validatorStatistics.retries << ", hedged: " << validatorStatistics.hedged << ", answered by the hedge: " << validatorStatistics.hedgeWins << std::endl;
+            }
+            
+            if (validatorStatistics.concurrencyLimit > 0)
+            {
+                std::cout << "\tconcurrency limit: " << validatorStatistics.concurrencyLimit << ", peak concurrency: " << validatorStatistics.peakConcurrency << ", backoffs: " << validatorStatistics.backoffs << std::endl;
+            }
+            
+            if (validatorStatistics.breakerOpened > 0)
+            {
+                std::cout << "\tcircuit breaker opened: " << validatorStatistics.breakerOpened << " times, requests failed fast: " << validatorStatistics.rejected << std::endl;
+            }
+            std::cout << std::endl;
+        }
+        
+        
+        
+        /*
+         5. Watch for changes
+         */
+        
+        if (watch && !indexUtils::statistics().watching)
+        {
+            shellUtils::setColor(shellTextColor::FG_RED);
+            std::cout << "Changes cannot be watched here (inotify unavailable, or over its watch limit)." << std::endl;
+            shellUtils::resetColor();
+        }
+        else if (watch)
+        {
+            std::cout << "Watching for changes, press Ctrl-C to stop..." << std::endl;
+            
+            cancelUtils::reset();
+            previousInterruptHandler = std::signal(SIGINT, cancelOnInterrupt);
+            
+            auto knownPaths = currentPaths;
+            std::set<std::string> changedPaths, changedOtherPaths;
+            
+            // Files of new or moved directories only show in the new snapshot.
+            while (indexUtils::waitForChanges(kWatchQuietSeconds, walkOptions, changedPaths, changedOtherPaths, paths))
+            {
+                std::set<std::string> currentPaths(paths.begin(), paths.end());
+                
+                std::set_symmetric_difference(knownPaths.begin(), knownPaths.end(), currentPaths.begin(), currentPaths.end(),
+                                              std::inserter(changedPaths, changedPaths.end()));
+                knownPaths.swap(currentPaths);
+                
+                // Any file may have been created or deleted, not only documents.
+                urlUtils::setKnownFiles(executablePath, paths);
+                
+                // Unchanged documents linking to changed files, documents or not, only have their
+                // links checked again: the validator's answer for their contents is cached.
+                std::set<std::string> referringPaths;
+                std::set<std::string> changedTargets(changedOtherPaths);
+                changedTargets.insert(changedPaths.begin(), changedPaths.end());
+                
+                for (auto &path : changedTargets)
+                {
+                    auto referrers = cacheUtils::getReferrers(path);
+                    
+                    if (referrers.empty())
+                    {
+                        continue;
+                    }
+                    
+                    cacheUtils::setSignature(path, fileUtils::getFileSignature(path));
+                    
+                    for (auto &referrer : referrers)
+                    {
+                        // Those out of the results are checked again by the next search.
+                        documentCache.eraseResult(referrer);
+                        cacheUtils::eraseDocument(referrer);
+                        
+                        if (changedPaths.count(referrer) == 0 && searchResults.count(referrer) > 0)
+                        {
+                            referringPaths.insert(referrer);
+                        }
+                    }
+                }
+                
+                // Files nothing links to, like the cache files written below, change nothing.
+                if (changedPaths.empty() && referringPaths.empty())
+                {
+                    continue;
+                }
+                
+                // Only changed documents are read, parsed and (unless cached) validated again.
+                // Referring documents come from the document cache, unless it evicted them.
+                std::map<std::string, document_t> changedDocuments;
+                threadUtils::taskGroup rereading(threadUtils::sharedPool());
+                
+                for (auto &path : changedPaths)
+                {
+                    searchResults.erase(path);
+                    
+                    if (knownPaths.count(path) > 0)
+                    {
+                        rereading.run([&prepareDocument, &path, &changedDocuments]() {
+                            prepareDocument(path, changedDocuments);
+                        });
+                    }
+                    else
+                    {
+                        documentCache.erase(path);
+                        cacheUtils::setLinks(path, {});
+                    }
+                }
+                
+                for (auto &path : referringPaths)
+                {
+                    rereading.run([&prepareDocument, &path, &changedDocuments]() {
+                        prepareDocument(path, changedDocuments);
+                    });
+                }
+                
+                rereading.wait();
+                
+                for (auto &path : changedPaths)
+                {
+                    documentPtr_t result;
+                    
+                    if (changedDocuments.count(path) > 0 && documentCache.lookupResult(path, changedDocuments[path].contentHash, result))
+                    {
+                        searchResults[path] = result;
+                        changedDocuments.erase(path);
+                    }
+                }
+                
+                threadUtils::taskGroup revalidations(threadUtils::sharedPool());
+                
+                for (auto &changedEntry : changedDocuments)
+                {
+                    auto &path = changedEntry.first;
+                    auto &document = changedEntry.second;
+                    
+                    revalidations.run([&path, &executablePath, &document, &revalidations]() {
+                        htmlUtils::validateHtml(path, executablePath, document, revalidations);
+                    });
+                }
+                
+                revalidations.wait();
+                
+                for (auto &changedEntry : changedDocuments)
+                {
+                    auto document = makeResult(std::move(changedEntry.second));
+                    searchResults[changedEntry.first] = document;
+                    
+                    if (isComplete(*document))
+                    {
+                        documentCache.storeResult(changedEntry.first, document);
+                        cacheUtils::storeDocument(changedEntry.first, cacheUtils::makeKey(backend->name(), document->contentHash), document->problems);
+                        
+                        bool erroring = std::any_of(document->problems.begin(), document->problems.end(), [](const problem_t &problem) {
+                            return problem.type.compare("error") == 0;
+                        });
+                        
+                        ledgerUtils::setErroring(changedEntry.first, erroring);
+                    }
+                }
+                
+                saveCaches();
+                
+                changedPaths.insert(referringPaths.begin(), referringPaths.end());
+                
+                // Only the changed part of the report is printed again.
+                std::map<std::string, ssize_t> changedData;
+                
+                for (auto &path : changedPaths)
+                {
+                    if (searchResults.count(path) > 0)
+                    {
+                        printDocument(path, *searchResults[path], changedData);
+                    }
+                    else if (knownPaths.count(path) == 0)
+                    {
+                        std::cout << std::endl << path << std::endl;
+                        shellUtils::setColor(shellTextColor::FG_DARK_GRAY);
+                        std::cout << "Removed" << std::endl;
+                        shellUtils::resetColor();
+                    }
+                }
+                
+                changedPaths.clear();
+            }
+            
+            std::signal(SIGINT, previousInterruptHandler);
+            std::cout << std::endl;
+        }
+        
         shellUtils::waitForInput("start new search");
     }
     
+    indexUtils::stop();
+    
     return 0;
 }
@@ -0,0 +1,500 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include "cacheUtils.hpp"
+#include "hashUtils.hpp"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// Bump whenever the meaning of the stored results changes, to discard older caches.
+#define kCacheVersion 1
+
+// Validator results not used by any of this many runs are dropped when the cache is saved.
+#define kRetainedRuns 30
+
+static std::mutex cacheMutex;
+static std::unordered_map<std::string, std::vector<problem_t>> entries;
+static std::unordered_map<std::string, size_t> entryRuns; // The last run which used each entry
+static size_t currentRun = 1; // Runs which saved the cache, this one included
+static bool dirty = false;
+
+// Link graph: the files each document links to, and the reverse.
+static std::map<std::string, std::set<std::string>> linkTargets;
+static std::map<std::string, std::set<std::string>> linkReferrers;
+static std::map<std::string, std::string> targetSignatures; // As of the last check of their referrers
+
+struct documentEntry_t
+{
+    std::string key;
+    std::vector<problem_t> problems;
+};
+
+static std::map<std::string, documentEntry_t> documents; // Path -> complete results
+
+/*
+ Record that this run used an entry. cacheMutex must be held.
+ */
+static void touchEntry(const std::string &key)
+{
+    auto &lastRun = entryRuns[key];
+    
+    // Saving the cache for every hit would rewrite it on every run: only do so once the
+    // entry gets old enough to be dropped soon.
+    if (currentRun - std::min(lastRun, currentRun) >= kRetainedRuns / 2)
+    {
+        dirty = true;
+    }
+    
+    lastRun = currentRun;
+}
+
+/*
+ Replace the targets of a document. cacheMutex must be held.
+ */
+static void replaceLinks(const std::string &path, const std::set<std::string> &targets)
+{
+    auto &previousTargets = linkTargets[path];
+    
+    for (auto &target : previousTargets)
+    {
+        linkReferrers[target].erase(path);
+        
+        if (linkReferrers[target].empty())
+        {
+            linkReferrers.erase(target);
+        }
+    }
+    
+    for (auto &target : targets)
+    {
+        linkReferrers[target].insert(path);
+    }
+    
+    previousTargets = targets;
+    
+    if (targets.empty())
+    {
+        linkTargets.erase(path);
+    }
+}
+
+static json problemToJson(const problem_t &problem)
+{
+    json ret;
+    
+    ret["type"] = problem.type;
+    ret["message"] = problem.message;
+    ret["extract"] = problem.extract;
+    ret["firstLine"] = problem.firstLine;
+    ret["firstColumn"] = problem.firstColumn;
+    ret["lastLine"] = problem.lastLine;
+    ret["lastColumn"] = problem.lastColumn;
+    
+    return ret;
+}
+
+static problem_t problemFromJson(const json &value)
+{
+    problem_t problem;
+    
+    problem.type = value["type"];
+    problem.message = value["message"];
+    problem.extract = value["extract"];
+    problem.firstLine = value["firstLine"];
+    problem.firstColumn = value["firstColumn"];
+    problem.lastLine = value["lastLine"];
+    problem.lastColumn = value["lastColumn"];
+    
+    return problem;
+}
+
+std::string cacheUtils::makeKey(const std::string &backend, uint64_t contentHash)
+{
+    return hashUtils::toHex(contentHash) + " " + backend;
+}
+
+void cacheUtils::load(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    entries.clear();
+    entryRuns.clear();
+    linkTargets.clear();
+    linkReferrers.clear();
+    targetSignatures.clear();
+    documents.clear();
+    currentRun = 1;
+    dirty = false;
+    
+    std::ifstream ifs(path);
+    
+    if (!ifs)
+    {
+        return;
+    }
+    
+    try
+    {
+        json cache = json::parse(ifs);
+        
+        if (cache.count("version") == 0 || cache["version"] != kCacheVersion)
+        {
+            return;
+        }
+        
+        // Older caches have no run counts: their entries count as used by the previous run.
+        if (cache.count("run") > 0)
+        {
+            currentRun = cache["run"].get<size_t>() + 1;
+        }
+        
+        for (auto it = cache["entries"].begin(); it != cache["entries"].end(); ++it)
+        {
+            auto &problems = entries[it.key()];
+            
+            for (auto &problem : it.value())
+            {
+                problems.push_back(problemFromJson(problem));
+            }
+            
+            bool hasRun = cache.count("entryRuns") > 0 && cache["entryRuns"].count(it.key()) > 0;
+            entryRuns[it.key()] = hasRun ? cache["entryRuns"][it.key()].get<size_t>() : currentRun - 1;
+        }
+        
+        // Older caches have no link graph: it is rebuilt as documents are validated.
+        if (cache.count("links") > 0)
+        {
+            for (auto it = cache["links"].begin(); it != cache["links"].end(); ++it)
+            {
+                replaceLinks(it.key(), it.value().get<std::set<std::string>>());
+            }
+        }
+        
+        // Neither have they signatures and documents: their documents are checked again.
+        if (cache.count("signatures") > 0 && cache.count("documents") > 0)
+        {
+            for (auto it = cache["signatures"].begin(); it != cache["signatures"].end(); ++it)
+            {
+                targetSignatures[it.key()] = it.value().get<std::string>();
+            }
+            
+            for (auto it = cache["documents"].begin(); it != cache["documents"].end(); ++it)
+            {
+                auto &document = documents[it.key()];
+                document.key = it.value()["key"];
+                
+                for (auto &problem : it.value()["problems"])
+                {
+                    document.problems.push_back(problemFromJson(problem));
+                }
+            }
+        }
+    }
+    catch (const std::exception &)
+    {
+        // A corrupted cache is just an empty one: everything will be validated again.
+        entries.clear();
+        entryRuns.clear();
+        linkTargets.clear();
+        linkReferrers.clear();
+        targetSignatures.clear();
+        documents.clear();
+    }
+}
+
+bool cacheUtils::save(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    if (!dirty)
+    {
+        return true;
+    }
+    
+    json cache;
+    cache["version"] = kCacheVersion;
+    cache["run"] = currentRun;
+    cache["entries"] = json::object();
+    cache["entryRuns"] = json::object();
+    
+    for (auto entry = entries.begin(); entry != entries.end();)
+    {
+        // Results of contents nobody has any more (or of another validator) would pile up.
+        auto &lastRun = entryRuns[entry->first];
+        
+        if (currentRun - std::min(lastRun, currentRun) >= kRetainedRuns)
+        {
+            entryRuns.erase(entry->first);
+            entry = entries.erase(entry);
+            continue;
+        }
+        
+        json problems = json::array();
+        
+        for (auto &problem : entry->second)
+        {
+            problems.push_back(problemToJson(problem));
+        }
+        
+        cache["entries"][entry->first] = problems;
+        cache["entryRuns"][entry->first] = lastRun;
+        ++entry;
+    }
+    
+    cache["links"] = json::object();
+    
+    for (auto &links : linkTargets)
+    {
+        cache["links"][links.first] = links.second;
+    }
+    
+    cache["signatures"] = json::object();
+    
+    // Files nothing links to any more need no signature.
+    for (auto &target : linkReferrers)
+    {
+        auto signature = targetSignatures.find(target.first);
+        
+        if (signature != targetSignatures.end())
+        {
+            cache["signatures"][target.first] = signature->second;
+        }
+    }
+    
+    cache["documents"] = json::object();
+    
+    for (auto &document : documents)
+    {
+        json problems = json::array();
+        
+        for (auto &problem : document.second.problems)
+        {
+            problems.push_back(problemToJson(problem));
+        }
+        
+        cache["documents"][document.first] = {{"key", document.second.key}, {"problems", problems}};
+    }
+    
+    // Write to a temporary file first, then swap it in.
+    std::string temporaryPath = path + ".tmp";
+    
+    {
+        std::ofstream ofs(temporaryPath);
+        ofs << cache.dump();
+        
+        if (!ofs)
+        {
+            return false;
+        }
+    }
+    
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        return false;
+    }
+    
+    dirty = false;
+    
+    return true;
+}
+
+bool cacheUtils::lookup(const std::string &key, std::vector<problem_t> &problems)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    auto entry = entries.find(key);
+    
+    if (entry == entries.end())
+    {
+        return false;
+    }
+    
+    problems = entry->second;
+    touchEntry(key);
+    
+    return true;
+}
+
+bool cacheUtils::contains(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return entries.count(key) > 0;
+}
+
+void cacheUtils::store(const std::string &key, const std::vector<problem_t> &problems)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    entries[key] = problems;
+    entryRuns[key] = currentRun;
+    dirty = true;
+}
+
+void cacheUtils::setLinks(const std::string &path, const std::set<std::string> &targets)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    auto previousTargets = linkTargets.find(path);
+    
+    if ((previousTargets == linkTargets.end() && targets.empty()) ||
+        (previousTargets != linkTargets.end() && previousTargets->second == targets))
+    {
+        return;
+    }
+    
+    replaceLinks(path, targets);
+    dirty = true;
+}
+
+std::set<std::string> cacheUtils::getReferrers(const std::string &target)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    auto referrers = linkReferrers.find(target);
+    
+    return referrers == linkReferrers.end() ? std::set<std::string>() : referrers->second;
+}
+
+std::vector<std::string> cacheUtils::getLinkedFiles()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    std::vector<std::string> ret;
+    ret.reserve(linkReferrers.size());
+    
+    for (auto &target : linkReferrers)
+    {
+        ret.push_back(target.first);
+    }
+    
+    return ret;
+}
+
+bool cacheUtils::getSignature(const std::string &target, std::string &signature)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    auto it = targetSignatures.find(target);
+    
+    if (it == targetSignatures.end())
+    {
+        return false;
+    }
+    
+    signature = it->second;
+    
+    return true;
+}
+
+void cacheUtils::setSignature(const std::string &target, const std::string &signature)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    auto &previousSignature = targetSignatures[target];
+    
+    if (previousSignature != signature)
+    {
+        previousSignature = signature;
+        dirty = true;
+    }
+}
+
+bool cacheUtils::lookupDocument(const std::string &path, const std::string &key, std::vector<problem_t> &problems)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    auto it = documents.find(path);
+    
+    if (it == documents.end() || it->second.key.compare(key) != 0)
+    {
+        return false;
+    }
+    
+    problems = it->second.problems;
+    
+    // Its validator results are needed again as soon as a file it links to changes.
+    if (entries.count(key) > 0)
+    {
+        touchEntry(key);
+    }
+    
+    return true;
+}
+
+void cacheUtils::storeDocument(const std::string &path, const std::string &key, const std::vector<problem_t> &problems)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    auto &document = documents[path];
+    document.key = key;
+    document.problems = problems;
+    dirty = true;
+}
+
+void cacheUtils::eraseDocument(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    if (documents.erase(path) > 0)
+    {
+        dirty = true;
+    }
+}
+
+std::vector<std::string> cacheUtils::getDocuments()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    std::vector<std::string> ret;
+    ret.reserve(documents.size());
+    
+    for (auto &document : documents)
+    {
+        ret.push_back(document.first);
+    }
+    
+    return ret;
+}
+
+void cacheUtils::clear()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    
+    entries.clear();
+    entryRuns.clear();
+    documents.clear();
+    dirty = true;
+}
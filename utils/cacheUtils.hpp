@@ -0,0 +1,203 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef cacheUtils_hpp
+#define cacheUtils_hpp
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "htmlUtils.hpp"
+
+namespace cacheUtils
+{
+    /*
+     @brief: given the name of a validator backend and the hash of a document's contents,
+            return the key its validation results are stored at. Paths play no part in it,
+            so results are shared by identical documents, across runs and machines.
+     
+     @param `backend` The name of the validator backend.
+     @param `contentHash` The hash of the bytes sent to the validator.
+     
+     @return std::string.
+     */
+    std::string makeKey(const std::string &backend, uint64_t contentHash);
+    
+    /*
+     @brief: load the persistent cache from a file, replacing the in-memory entries.
+            A missing or unreadable file results in an empty cache.
+     
+     @param `path` The path to the cache file.
+     
+     @return void.
+     */
+    void load(const std::string &path);
+    
+    /*
+     @brief: write the cache to a file, if it changed since it was loaded.
+            The file is replaced atomically, so an interrupted run never corrupts it.
+            Validator results which none of the last runs looked up or stored are dropped.
+     
+     @param `path` The path to the cache file.
+     
+     @return bool. False if the file could not be written.
+     */
+    bool save(const std::string &path);
+    
+    /*
+     @brief: look for the validation results stored at `key`. Safe to call concurrently.
+     
+     @param `key` See makeKey.
+     @param `problems` Set to the cached results, if any.
+     
+     @return bool. Whether the key was found.
+     */
+    bool lookup(const std::string &key, std::vector<problem_t> &problems);
+    
+    /*
+     @brief: return whether validation results are stored at `key`, without using them.
+            Safe to call concurrently.
+     
+     @param `key` See makeKey.
+     
+     @return bool.
+     */
+    bool contains(const std::string &key);
+    
+    /*
+     @brief: store validation results at `key`. Safe to call concurrently.
+     
+     @param `key` See makeKey.
+     @param `problems` The validation results.
+     
+     @return void.
+     */
+    void store(const std::string &key, const std::vector<problem_t> &problems);
+    
+    /*
+     @brief: record the local files a document links to, replacing those recorded before.
+            The reverse link graph is saved along with the results. Safe to call concurrently.
+     
+     @param `path` The path to the document.
+     @param `targets` The paths of the files it links to (see urlUtils::resolveLocalPath).
+     
+     @return void.
+     */
+    void setLinks(const std::string &path, const std::set<std::string> &targets);
+    
+    /*
+     @brief: return the documents linking to a file, whatever the anchor. Safe to call concurrently.
+     
+     @param `target` The path to the file.
+     
+     @return std::set<std::string>.
+     */
+    std::set<std::string> getReferrers(const std::string &target);
+    
+    /*
+     @brief: return every file linked to by a document, sorted.
+     
+     @return std::vector<std::string>.
+     */
+    std::vector<std::string> getLinkedFiles();
+    
+    /*
+     @brief: return the signature a linked file had when the documents linking to it were
+            last checked (see fileUtils::getFileSignature). Safe to call concurrently.
+     
+     @param `target` The path to the file.
+     @param `signature` Set to its signature, empty if it did not exist.
+     
+     @return bool. False if none was recorded.
+     */
+    bool getSignature(const std::string &target, std::string &signature);
+    
+    /*
+     @brief: record the signature of a linked file, before the documents linking to it are
+            checked against it. Safe to call concurrently.
+     
+     @param `target` The path to the file.
+     @param `signature` Its signature, empty if it does not exist.
+     
+     @return void.
+     */
+    void setSignature(const std::string &target, const std::string &signature);
+    
+    /*
+     @brief: look up the complete results of a document (its links and the validator's
+            answer), as of its last check. Safe to call concurrently.
+     
+     @param `path` The path to the document.
+     @param `key` See makeKey: results of other contents, or of another validator, are stale.
+     @param `problems` Set to the stored results, if any.
+     
+     @return bool. Whether results were stored for this key.
+     */
+    bool lookupDocument(const std::string &path, const std::string &key, std::vector<problem_t> &problems);
+    
+    /*
+     @brief: store the complete results of a document. Unlike validator results, they hold for
+            this path only, and until a file it links to changes (see eraseDocument).
+            Safe to call concurrently.
+     
+     @param `path` The path to the document.
+     @param `key` See makeKey.
+     @param `problems` Its results.
+     
+     @return void.
+     */
+    void storeDocument(const std::string &path, const std::string &key, const std::vector<problem_t> &problems);
+    
+    /*
+     @brief: forget the results of a document, e.g. because a file it links to changed.
+            Safe to call concurrently.
+     
+     @param `path` The path to the document.
+     
+     @return void.
+     */
+    void eraseDocument(const std::string &path);
+    
+    /*
+     @brief: return the path of every document with stored results, sorted.
+     
+     @return std::vector<std::string>.
+     */
+    std::vector<std::string> getDocuments();
+    
+    /*
+     @brief: remove all validator and document results. The link graph is kept.
+     
+     @return void.
+     */
+    void clear();
+}
+
+#endif /* cacheUtils_hpp */
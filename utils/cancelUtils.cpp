@@ -0,0 +1,110 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "cancelUtils.hpp"
+
+typedef std::chrono::steady_clock steadyClock_t;
+
+// Sleeps are sliced, so that cancellation is noticed quickly.
+#define kSleepSliceSeconds 0.05
+
+// Both are read by every validation thread, hence atomics instead of a mutex.
+// The deadline is stored as a steady_clock tick count, 0 meaning "no deadline".
+static std::atomic<bool> cancelRequested(false);
+static std::atomic<long long> deadlineTicks(0);
+
+void cancelUtils::setDeadline(double seconds)
+{
+    if (seconds <= 0)
+    {
+        deadlineTicks = 0;
+        return;
+    }
+    
+    auto deadline = steadyClock_t::now() + std::chrono::duration_cast<steadyClock_t::duration>(std::chrono::duration<double>(seconds));
+    deadlineTicks = deadline.time_since_epoch().count();
+}
+
+void cancelUtils::cancel()
+{
+    cancelRequested = true;
+}
+
+void cancelUtils::reset()
+{
+    cancelRequested = false;
+    deadlineTicks = 0;
+}
+
+bool cancelUtils::isCancelled()
+{
+    return cancelRequested || remainingSeconds() == 0;
+}
+
+double cancelUtils::remainingSeconds()
+{
+    long long ticks = deadlineTicks;
+    
+    if (ticks == 0)
+    {
+        return -1;
+    }
+    
+    auto remaining = steadyClock_t::duration(ticks) - steadyClock_t::now().time_since_epoch();
+    
+    if (remaining.count() <= 0)
+    {
+        return 0;
+    }
+    
+    return std::chrono::duration<double>(remaining).count();
+}
+
+bool cancelUtils::sleepFor(double seconds)
+{
+    auto end = steadyClock_t::now() + std::chrono::duration_cast<steadyClock_t::duration>(std::chrono::duration<double>(seconds));
+    
+    while (!isCancelled())
+    {
+        auto remaining = std::chrono::duration<double>(end - steadyClock_t::now()).count();
+        
+        if (remaining <= 0)
+        {
+            return true;
+        }
+        
+        std::this_thread::sleep_for(std::chrono::duration<double>(std::min(remaining, kSleepSliceSeconds)));
+    }
+    
+    return false;
+}
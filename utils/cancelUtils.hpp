@@ -0,0 +1,85 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef cancelUtils_hpp
+#define cancelUtils_hpp
+
+namespace cancelUtils
+{
+    /*
+     @brief: start a whole-run deadline `seconds` from now. Once it expires, every
+            outstanding check is expected to give up as soon as it notices.
+            A value <= 0 disables the deadline.
+     
+     @param `seconds` The time budget of the run.
+     
+     @return void.
+     */
+    void setDeadline(double seconds);
+    
+    /*
+     @brief: request the cooperative cancellation of all outstanding checks.
+            Only touches an atomic flag, so it is safe to call from a signal handler.
+     
+     @return void.
+     */
+    void cancel();
+    
+    /*
+     @brief: clear both the deadline and any pending cancellation request.
+     
+     @return void.
+     */
+    void reset();
+    
+    /*
+     @brief: return whether outstanding checks should stop, either because cancel()
+            was called or because the deadline expired.
+     
+     @return bool.
+     */
+    bool isCancelled();
+    
+    /*
+     @brief: return the number of seconds left before the deadline expires.
+     
+     @return double. Negative if no deadline was set, 0 if it already expired.
+     */
+    double remainingSeconds();
+    
+    /*
+     @brief: sleep for `seconds`, waking up early if the checks are cancelled meanwhile.
+     
+     @param `seconds` The duration of the sleep.
+     
+     @return bool. False if the checks were cancelled.
+     */
+    bool sleepFor(double seconds);
+}
+
+#endif /* cancelUtils_hpp */
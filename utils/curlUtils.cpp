@@ -26,15 +26,115 @@
  SOFTWARE.
  */
 
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "cancelUtils.hpp"
 #include "curlUtils.hpp"
 #include "shellUtils.hpp"
+#include "threadUtils.hpp"
+
+// curl exits with this code (and prints it as "curl: (28) ...") on timeouts.
+#define kCurlTimeoutError "curl: (28)"
+
+// How often running requests check for cancellations.
+#define kCancelCheckSeconds 0.1
+
+// Appended by curl to the validator's answer, followed by the http status code.
+#define kHttpStatusMarker "\nhttp_status="
+
+static std::atomic<double> connectTimeout(10);
+static std::atomic<double> totalTimeout(60);
+
+// Requests share nothing with the terminal, and are killed along with their children.
+static const processOptions_t requestOptions = {true, true, 0};
+
+/*
+ Return the timeout arguments for the next curl invocation, or an empty vector
+ if the run deadline already expired and the request should not be sent at all.
+ */
+static std::vector<std::string> timeoutArguments()
+{
+    double total = totalTimeout;
+    double remaining = cancelUtils::remainingSeconds();
+    
+    if (remaining == 0)
+    {
+        return {};
+    }
+    else if (remaining > 0 && remaining < total)
+    {
+        total = remaining;
+    }
+    
+    return {"--connect-timeout", std::to_string(connectTimeout.load()), "--max-time", std::to_string(total)};
+}
+
+/*
+ Return the first line of a command's output, with its line break.
+ */
+static std::string firstLine(const std::string &output)
+{
+    auto endIdx = output.find('\n');
+    return endIdx == std::string::npos ? output : output.substr(0, endIdx + 1);
+}
+
+/*
+ Return the arguments of a curl invocation fetching the headers of `url`.
+ */
+static std::vector<std::string> headArguments(const std::string &url, const std::vector<std::string> &timeouts)
+{
+    std::vector<std::string> arguments = {"curl", "-IsSk"};
+    arguments.insert(arguments.end(), timeouts.begin(), timeouts.end());
+    arguments.push_back(url);
+    
+    return arguments;
+}
+
+/*
+ Run curl on the I/O pool, which bounds the number of concurrent requests.
+ */
+static std::string execRequest(const std::vector<std::string> &arguments)
+{
+    std::string response;
+    
+    threadUtils::runBlocking([&arguments, &response]() {
+        response = shellUtils::run(arguments, "", 0, requestOptions).output;
+    });
+    
+    return response;
+}
+
+void curlUtils::setTimeouts(double connectSeconds, double totalSeconds)
+{
+    connectTimeout = connectSeconds;
+    totalTimeout = totalSeconds;
+}
 
 std::string curlUtils::getWebsiteState(const std::string &url)
 {
-    return shellUtils::exec("curl -IsSk \"" + url + "\" | head -1");
+    auto timeouts = timeoutArguments();
+    
+    if (timeouts.size() == 0)
+    {
+        return kCurlTimeoutError " Run deadline exceeded";
+    }
+    
+    // Errors are merged into the output, so that curl's errors (e.g. timeouts) end up in the first line too.
+    return firstLine(execRequest(headArguments(url, timeouts)));
 }
 
-bool curlUtils::isWebsiteOk(const std::string &url)
+std::string curlUtils::probeWebsite(const std::string &url)
+{
+    std::vector<std::string> timeouts = {"--connect-timeout", std::to_string(connectTimeout.load()), "--max-time", std::to_string(totalTimeout.load())};
+    
+    return firstLine(shellUtils::run(headArguments(url, timeouts), "", 0, requestOptions).output);
+}
+
+websiteState curlUtils::checkWebsite(const std::string &url)
 {
     // BUGFIX:
     // -k disables insecure certificates. After all, this only checks the health of a website
@@ -42,23 +142,184 @@ bool curlUtils::isWebsiteOk(const std::string &url)
     
     std::string response = curlUtils::getWebsiteState(url);
     
-    return
+    if (curlUtils::isTimeoutResponse(response))
+    {
+        return WEBSITE_TIMED_OUT;
+    }
+    
+    bool ok =
+    response.find("curl: (") == std::string::npos &&
     response.find("40") == std::string::npos &&
     response.find("41") == std::string::npos &&
-    response.find("50") == std::string::npos &&
-    response.find("Operation timed out") == std::string::npos;
+    response.find("50") == std::string::npos;
+    
+    return ok ? WEBSITE_OK : WEBSITE_BROKEN;
 }
 
-std::string curlUtils::validateHTML(const std::string &path)
+bool curlUtils::isWebsiteOk(const std::string &url)
 {
-    // Validate via validator.w3.org
+    return curlUtils::checkWebsite(url) == WEBSITE_OK;
+}
+
+bool curlUtils::isTimeoutResponse(const std::string &response)
+{
+    // Not just a prefix check: a timeout may interrupt a partially received body.
+    return response.find(kCurlTimeoutError) != std::string::npos;
+}
+
+/*
+ Return the arguments of a curl invocation sending a document, read from its standard input,
+ to a Nu compatible validator.
+ */
+static std::vector<std::string> validateArguments(const std::string &url, const std::vector<std::string> &timeouts, bool compressed)
+{
+    // Validate via validator.w3.org, or any service implementing the same api.
+    // Gzipped bodies are accepted too.
     /*
      Source: https://github.com/validator/validator/wiki/Service:-Input:-POST-body
      */
-    std::string curlValidateCommand =
-    "curl -sS -H \"Content-Type: text/html; charset=utf-8\" "
-    "--data-binary \"@" + path + "\" "
-    "https://validator.w3.org/nu/?out=json";
+    std::vector<std::string> arguments = {"curl", "-sS"};
+    arguments.insert(arguments.end(), timeouts.begin(), timeouts.end());
+    arguments.insert(arguments.end(), {"-H", "Content-Type: text/html; charset=utf-8"});
+    
+    if (compressed)
+    {
+        arguments.insert(arguments.end(), {"-H", "Content-Encoding: gzip"});
+    }
+    
+    arguments.insert(arguments.end(), {"-w", kHttpStatusMarker "%{http_code}\n", "--data-binary", "@-"});
+    arguments.push_back(url + (url.find('?') == std::string::npos ? "?" : "&") + "out=json");
+    
+    return arguments;
+}
+
+/*
+ Return whether the output of a validate command holds a json answer, as opposed to nothing
+ or curl's error message.
+ */
+static bool hasAnswer(const std::string &output)
+{
+    return output.length() > 0 && output.front() == '{';
+}
+
+std::string curlUtils::validateHTML(const char *body, size_t length, const std::string &url, bool compress, int &httpStatus, size_t &bytesSent)
+{
+    bool hedgeSent, hedgeAnswered;
+    
+    return curlUtils::hedgedValidateHTML(body, length, url, "", 0, compress, httpStatus, hedgeSent, hedgeAnswered, bytesSent);
+}
+
+std::string curlUtils::hedgedValidateHTML(const char *body, size_t length, const std::string &url, const std::string &hedgeUrl, double hedgeDelay, bool compress, int &httpStatus, bool &hedgeSent, bool &hedgeAnswered, size_t &bytesSent)
+{
+    httpStatus = 0;
+    hedgeSent = false;
+    hedgeAnswered = false;
+    bytesSent = 0;
+    
+    auto timeouts = timeoutArguments();
+    
+    if (timeouts.size() == 0)
+    {
+        return kCurlTimeoutError " Run deadline exceeded";
+    }
+    
+    std::string compressedBody;
+    
+    if (compress)
+    {
+        // Compressed once, for both the request and its hedge.
+        processOptions_t options = {false, true, 0};
+        auto gzip = shellUtils::run({"gzip", "-c", "-1"}, body, length, options);
+        
+        if (gzip.exitStatus == 0)
+        {
+            compressedBody.swap(gzip.output);
+            body = compressedBody.data();
+            length = compressedBody.length();
+        }
+        else
+        {
+            compress = false;
+        }
+    }
+    
+    std::string response;
+    bytesSent = length;
+    
+    // Still counted as a single slot of the I/O pool: the hedge replaces a request stuck elsewhere.
+    threadUtils::runBlocking([&]() {
+        auto begin = std::chrono::steady_clock::now();
+        
+        std::vector<std::unique_ptr<shellUtils::childProcess>> requests;
+        std::vector<shellUtils::childProcess *> running;
+        
+        requests.emplace_back(new shellUtils::childProcess(validateArguments(url, timeouts, compress), body, length, requestOptions));
+        running.push_back(requests.back().get());
+        
+        while (true)
+        {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            bool canHedge = hedgeUrl.length() > 0 && !hedgeSent;
+            
+            if (canHedge && elapsed >= hedgeDelay)
+            {
+                // The primary is slower than usual: race it against the other endpoint.
+                hedgeSent = true;
+                canHedge = false;
+                bytesSent += length;
+                requests.emplace_back(new shellUtils::childProcess(validateArguments(hedgeUrl, timeouts, compress), body, length, requestOptions));
+                running.push_back(requests.back().get());
+            }
+            
+            // Wake up regularly to notice cancellations, since the requests do not get Ctrl-C.
+            double wait = kCancelCheckSeconds;
+            
+            if (canHedge)
+            {
+                wait = std::min(wait, hedgeDelay - elapsed);
+            }
+            
+            int finishedIdx = shellUtils::childProcess::waitAny(running, wait);
+            
+            if (finishedIdx >= 0)
+            {
+                auto finished = running[finishedIdx];
+                running.erase(running.begin() + finishedIdx);
+                
+                // An empty or failed answer does not win the race while another request may still answer.
+                if (hasAnswer(finished->output()) || (running.size() == 0 && !canHedge))
+                {
+                    response = finished->output();
+                    hedgeAnswered = finished != requests.front().get();
+                    break;
+                }
+                
+                if (running.size() == 0)
+                {
+                    // Send the hedge right away instead of waiting for the delay.
+                    hedgeDelay = 0;
+                    response = finished->output();
+                }
+            }
+            
+            if (cancelUtils::isCancelled())
+            {
+                // The remaining requests are killed with their process objects.
+                response = kCurlTimeoutError " Run cancelled";
+                break;
+            }
+        }
+    });
+    
+    // Cut the status line out of the response, wherever curl's error messages put it.
+    auto markerIdx = response.rfind(kHttpStatusMarker);
+    
+    if (markerIdx != std::string::npos)
+    {
+        auto endIdx = response.find('\n', markerIdx + 1);
+        httpStatus = std::atoi(response.c_str() + markerIdx + sizeof(kHttpStatusMarker) - 1);
+        response.erase(markerIdx, endIdx == std::string::npos ? std::string::npos : endIdx - markerIdx + 1);
+    }
     
-    return shellUtils::exec(curlValidateCommand);
+    return response;
 }
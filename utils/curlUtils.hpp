@@ -31,23 +31,57 @@
 
 #include <string>
 
+enum websiteState
+{
+    WEBSITE_OK,
+    WEBSITE_BROKEN,
+    WEBSITE_TIMED_OUT
+};
+
 namespace curlUtils
 {
+    /*
+     @brief: set the timeouts applied to every request. The total timeout is further
+            clamped to whatever is left of the run deadline (see cancelUtils).
+     
+     @param `connectSeconds` Maximum time allowed to establish a connection.
+     @param `totalSeconds` Maximum time allowed for the whole request.
+     
+     @return void.
+     */
+    void setTimeouts(double connectSeconds, double totalSeconds);
     
     /**
-     <#Description#>
+     Return the status line of the website's answer (e.g. "HTTP/1.1 200 OK").
+     If curl fails, its error message is returned instead.
 
-     @param url <#url description#>
-     @return <#return value description#>
+     @param url A string representation of the url.
+     @return The first line of curl's output.
      */
     std::string getWebsiteState(const std::string &url);
     
     /*
-     @brief: given an url to a website, return whether the website's answer was 200.
+     @brief: like getWebsiteState, but run curl on the calling thread, outside of the I/O
+            pool, and ignore the run deadline. Meant for background health probes.
+     
+     @param `url` A string representation of the url.
      
-     #TODO
-     Known bugs:
-      - unable to catch timeout errors
+     @return std::string. The first line of curl's output.
+     */
+    std::string probeWebsite(const std::string &url);
+    
+    /*
+     @brief: given an url to a website, return whether the website answered, failed
+            or did not answer in time.
+     
+     @param `url` A string representation of the url.
+     
+     @return websiteState.
+     */
+    websiteState checkWebsite(const std::string &url);
+    
+    /*
+     @brief: given an url to a website, return whether the website's answer was 200.
      
      @param `url` A string representation of the url.
      
@@ -56,14 +90,55 @@ namespace curlUtils
     bool isWebsiteOk(const std::string &url);
     
     /*
-     @brief: given a path to a file, send that file to w3's validator api and return
-            its response as a string.
+     @brief: given the output of a curl invocation, return whether it failed
+            because of a timeout.
+     
+     @param `response` The output of curl, including its error messages.
+     
+     @return bool.
+     */
+    bool isTimeoutResponse(const std::string &response);
+    
+    /*
+     @brief: given the bytes of an html document, send them to a Nu Html Checker compatible
+            validator (e.g. https://validator.w3.org/nu/) and return its json response
+            as a string. If curl fails, the string holds its error message instead
+            (see isTimeoutResponse).
+            The bytes are piped to curl from memory (e.g. those hashed by the read stage, see
+            document_t::file): the file is not read again. Cancellation (see cancelUtils)
+            kills the request.
+     
+     @param `body` The bytes of the document.
+     @param `length` The number of bytes of the document.
+     @param `url` The url of the validator.
+     @param `compress` Whether to gzip the request body. Only worth it for big documents.
+     @param `httpStatus` Set to the http status code of the answer, 0 if there was none.
+     @param `bytesSent` Set to the number of bytes handed to curl, after compression.
+     
+     @return std::string.
+     */
+    std::string validateHTML(const char *body, size_t length, const std::string &url, bool compress, int &httpStatus, size_t &bytesSent);
+    
+    /*
+     @brief: like validateHTML, but if `url` did not answer after `hedgeDelay` seconds (or
+            failed to answer), also send the document to `hedgeUrl`, and return the first
+            json answer of either. The slower request is killed.
      
-     @param `path` The path to a file.
+     @param `body` The bytes of the document.
+     @param `length` The number of bytes of the document.
+     @param `url` The url of the validator.
+     @param `hedgeUrl` The url of the second validator. Empty to never hedge.
+     @param `hedgeDelay` The number of seconds to wait for `url` before hedging.
+     @param `compress` Whether to gzip the request body.
+     @param `httpStatus` Set to the http status code of the answer, 0 if there was none.
+     @param `hedgeSent` Set to whether the document was sent to `hedgeUrl`.
+     @param `hedgeAnswered` Set to whether the returned answer came from `hedgeUrl`.
+     @param `bytesSent` Set to the number of bytes handed to curl, after compression, for
+            both requests.
      
      @return std::string.
      */
-    std::string validateHTML(const std::string &path);
+    std::string hedgedValidateHTML(const char *body, size_t length, const std::string &url, const std::string &hedgeUrl, double hedgeDelay, bool compress, int &httpStatus, bool &hedgeSent, bool &hedgeAnswered, size_t &bytesSent);
 }
 
 #endif /* curlUtils_hpp */
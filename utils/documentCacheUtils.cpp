@@ -0,0 +1,397 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "documentCacheUtils.hpp"
+
+#include <algorithm>
+
+/*
+ ###############################################################################
+ Static, private methods used to estimate the memory held by documents.
+ */
+
+// Heap blocks cost more than their size: allocator headers and alignment.
+#define kAllocationOverhead 16
+
+static size_t stringBytes(const std::string &string)
+{
+    // Short strings live inside the object.
+    return string.capacity() > 15 ? string.capacity() + 1 + kAllocationOverhead : 0;
+}
+
+static size_t elementBytes(const elementData &element)
+{
+    size_t bytes = stringBytes(element.tag) + stringBytes(element.stringRepresentation) + stringBytes(element.content);
+    
+    bytes += element.attributes.bucket_count() * sizeof(void *);
+    
+    for (auto &attribute : element.attributes)
+    {
+        // Each attribute is a node holding the pair, the next node and the cached hash.
+        bytes += sizeof(attribute) + 2 * sizeof(void *) + kAllocationOverhead;
+        bytes += stringBytes(attribute.first) + stringBytes(attribute.second);
+    }
+    
+    bytes += element.children.capacity() * sizeof(elementData) + kAllocationOverhead;
+    
+    for (auto &child : element.children)
+    {
+        bytes += elementBytes(child);
+    }
+    
+    return bytes;
+}
+
+static size_t treeBytes(const elementsTree_t &tree)
+{
+    size_t bytes = sizeof(tree) + tree.capacity() * sizeof(elementData) + kAllocationOverhead;
+    
+    for (auto &element : tree)
+    {
+        bytes += elementBytes(element);
+    }
+    
+    return bytes;
+}
+
+static size_t resultBytes(const document_t &document)
+{
+    size_t bytes = sizeof(document) + kAllocationOverhead + stringBytes(document.author);
+    
+    bytes += document.problems.capacity() * sizeof(problem_t) + kAllocationOverhead;
+    
+    for (auto &problem : document.problems)
+    {
+        bytes += stringBytes(problem.type) + stringBytes(problem.message) + stringBytes(problem.extract);
+    }
+    
+    return bytes;
+}
+
+/*
+ End static, private methods.
+ ###############################################################################
+ */
+
+documentCacheUtils::documentCache::documentCache(size_t budget) :
+budget(budget), bytes(0), peakBytes(0), textHits(0), textMisses(0), treeHits(0), treeMisses(0), resultHits(0), resultMisses(0), evictions()
+{
+}
+
+void documentCacheUtils::documentCache::setBudget(size_t budget)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    this->budget = budget;
+    evict();
+}
+
+bool documentCacheUtils::documentCache::hasSignature(const std::string &path, const std::string &signature)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto it = entries.find(path);
+    return it != entries.end() && it->second.signature.compare(signature) == 0;
+}
+
+bool documentCacheUtils::documentCache::lookupContents(const std::string &path, const std::string &signature, documentContents_t &contents)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto it = entries.find(path);
+    
+    if (it == entries.end() || it->second.signature.compare(signature) != 0 || !it->second.plaintext)
+    {
+        ++textMisses;
+        return false;
+    }
+    
+    ++textHits;
+    touch(it, TIER_TEXT);
+    
+    contents.plaintext = it->second.plaintext;
+    contents.contentHash = it->second.contentHash;
+    contents.tree = it->second.tree;
+    
+    if (contents.tree)
+    {
+        ++treeHits;
+        touch(it, TIER_TREE);
+    }
+    else
+    {
+        ++treeMisses;
+    }
+    
+    return true;
+}
+
+void documentCacheUtils::documentCache::storeContents(const std::string &path, const std::string &signature, const documentContents_t &contents)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto it = find(path, signature);
+    auto &entry = it->second;
+    
+    drop(it, TIER_TEXT);
+    drop(it, TIER_TREE);
+    
+    // Results of other contents would never be served again.
+    if (entry.contentHash != contents.contentHash)
+    {
+        drop(it, TIER_RESULT);
+    }
+    
+    entry.contentHash = contents.contentHash;
+    entry.plaintext = contents.plaintext;
+    insert(it, TIER_TEXT, sizeof(std::string) + stringBytes(*contents.plaintext) + kAllocationOverhead);
+    
+    evict();
+}
+
+void documentCacheUtils::documentCache::storeTree(const std::string &path, const std::string &signature, const std::shared_ptr<const elementsTree_t> &tree)
+{
+    size_t size = treeBytes(*tree);
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto it = entries.find(path);
+    
+    if (it == entries.end() || it->second.signature.compare(signature) != 0 || !it->second.plaintext)
+    {
+        return;
+    }
+    
+    drop(it, TIER_TREE);
+    
+    it->second.tree = tree;
+    insert(it, TIER_TREE, size);
+    
+    evict();
+}
+
+bool documentCacheUtils::documentCache::lookupResult(const std::string &path, uint64_t contentHash, documentPtr_t &result)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto it = entries.find(path);
+    
+    if (it == entries.end() || !it->second.result || it->second.result->contentHash != contentHash)
+    {
+        ++resultMisses;
+        return false;
+    }
+    
+    ++resultHits;
+    touch(it, TIER_RESULT);
+    
+    result = it->second.result;
+    return true;
+}
+
+void documentCacheUtils::documentCache::storeResult(const std::string &path, const documentPtr_t &result)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto it = entries.find(path);
+    
+    // Results are only stored for files read, hence with a signature.
+    if (it == entries.end())
+    {
+        return;
+    }
+    
+    drop(it, TIER_RESULT);
+    
+    it->second.result = result;
+    insert(it, TIER_RESULT, resultBytes(*result));
+    
+    evict();
+}
+
+void documentCacheUtils::documentCache::erase(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto it = entries.find(path);
+    
+    if (it == entries.end())
+    {
+        return;
+    }
+    
+    for (size_t level = 0; level < TIERS_COUNT; ++level)
+    {
+        drop(it, (tier)level);
+    }
+    
+    bytes -= it->second.baseBytes;
+    entries.erase(it);
+}
+
+void documentCacheUtils::documentCache::eraseResult(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto it = entries.find(path);
+    
+    if (it != entries.end())
+    {
+        drop(it, TIER_RESULT);
+    }
+}
+
+void documentCacheUtils::documentCache::clearResults()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    while (lru[TIER_RESULT].size() > 0)
+    {
+        drop(lru[TIER_RESULT].back(), TIER_RESULT);
+    }
+}
+
+std::vector<std::string> documentCacheUtils::documentCache::paths()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    std::vector<std::string> paths;
+    paths.reserve(entries.size());
+    
+    for (auto &entry : entries)
+    {
+        paths.push_back(entry.first);
+    }
+    
+    return paths;
+}
+
+documentCacheStatistics_t documentCacheUtils::documentCache::statistics()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    documentCacheStatistics_t statistics;
+    statistics.budget = budget;
+    statistics.bytes = bytes;
+    statistics.peakBytes = peakBytes;
+    statistics.documents = entries.size();
+    statistics.textHits = textHits;
+    statistics.textMisses = textMisses;
+    statistics.treeHits = treeHits;
+    statistics.treeMisses = treeMisses;
+    statistics.resultHits = resultHits;
+    statistics.resultMisses = resultMisses;
+    statistics.textEvictions = evictions[TIER_TEXT];
+    statistics.treeEvictions = evictions[TIER_TREE];
+    statistics.resultEvictions = evictions[TIER_RESULT];
+    
+    return statistics;
+}
+
+documentCacheUtils::documentCache::entries_t::iterator documentCacheUtils::documentCache::find(const std::string &path, const std::string &signature)
+{
+    auto it = entries.find(path);
+    
+    if (it == entries.end())
+    {
+        it = entries.emplace(path, entry_t()).first;
+        it->second.contentHash = 0;
+        it->second.baseBytes = sizeof(*it) + 3 * sizeof(void *) + kAllocationOverhead + stringBytes(path);
+        
+        for (size_t level = 0; level < TIERS_COUNT; ++level)
+        {
+            it->second.bytes[level] = 0;
+        }
+        
+        bytes += it->second.baseBytes;
+    }
+    
+    bytes -= stringBytes(it->second.signature);
+    it->second.signature = signature;
+    bytes += stringBytes(it->second.signature);
+    
+    return it;
+}
+
+void documentCacheUtils::documentCache::touch(entries_t::iterator it, tier level)
+{
+    auto &list = lru[level];
+    list.splice(list.begin(), list, it->second.positions[level]);
+}
+
+void documentCacheUtils::documentCache::insert(entries_t::iterator it, tier level, size_t size)
+{
+    lru[level].push_front(it);
+    it->second.positions[level] = lru[level].begin();
+    it->second.bytes[level] = size;
+    
+    bytes += size;
+    peakBytes = std::max(peakBytes, bytes);
+}
+
+void documentCacheUtils::documentCache::drop(entries_t::iterator it, tier level)
+{
+    auto &entry = it->second;
+    
+    if (entry.bytes[level] == 0)
+    {
+        return;
+    }
+    
+    lru[level].erase(entry.positions[level]);
+    bytes -= entry.bytes[level];
+    entry.bytes[level] = 0;
+    
+    switch (level)
+    {
+        case TIER_TREE:
+            entry.tree.reset();
+            break;
+        case TIER_TEXT:
+            entry.plaintext.reset();
+            break;
+        default:
+            entry.result.reset();
+            break;
+    }
+}
+
+void documentCacheUtils::documentCache::evict()
+{
+    // Trees go first, then texts, then results: each the least recently used first.
+    for (size_t level = 0; level < TIERS_COUNT && bytes > budget; ++level)
+    {
+        auto &list = lru[level];
+        
+        while (list.size() > 0 && bytes > budget)
+        {
+            drop(list.back(), (tier)level);
+            ++evictions[level];
+        }
+    }
+}
@@ -0,0 +1,225 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef documentCacheUtils_hpp
+#define documentCacheUtils_hpp
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "htmlUtils.hpp"
+
+/*
+ What is known of a file's current contents: null pointers were never computed, or evicted.
+ */
+struct documentContents_t
+{
+    std::shared_ptr<const std::string> plaintext;
+    uint64_t contentHash;
+    std::shared_ptr<const elementsTree_t> tree;
+};
+
+struct documentCacheStatistics_t
+{
+    size_t budget, bytes, peakBytes, documents;
+    size_t textHits, textMisses, treeHits, treeMisses, resultHits, resultMisses;
+    size_t textEvictions, treeEvictions, resultEvictions;
+};
+
+namespace documentCacheUtils
+{
+    /*
+     The documents of the last searches, kept in memory between them within a budget of bytes.
+     For each file it holds its signature, text, tree and checked result: over budget, the least
+     recently used trees are evicted first, since parsing them again is cheap, then texts, which
+     are read again from the disk, and results last, since checking them again costs network.
+     Signatures are never evicted: changes and deletions are detected against them.
+     Thread-safe.
+     */
+    class documentCache
+    {
+    public:
+        explicit documentCache(size_t budget);
+        
+        /*
+         @brief: change the budget, evicting what no longer fits.
+         
+         @param `budget` The memory budget, in bytes.
+         
+         @return void.
+         */
+        void setBudget(size_t budget);
+        
+        /*
+         @brief: return whether a file was cached with this signature. Not counted as a hit or a miss.
+         
+         @param `path` The path to the file.
+         @param `signature` See fileUtils::getFileSignature.
+         
+         @return bool.
+         */
+        bool hasSignature(const std::string &path, const std::string &signature);
+        
+        /*
+         @brief: look up the contents of an unchanged file.
+         
+         @param `path` The path to the file.
+         @param `signature` The current signature of the file.
+         @param `contents` Set to the cached contents. The tree is null when it must be parsed again.
+         
+         @return bool. Whether the text was cached for this signature.
+         */
+        bool lookupContents(const std::string &path, const std::string &signature, documentContents_t &contents);
+        
+        /*
+         @brief: cache the text of a file just read, dropping whatever was cached for another signature.
+         
+         @param `path` The path to the file.
+         @param `signature` The signature of the file when it was read.
+         @param `contents` Its text and hash. The tree, if any, is ignored: see storeTree.
+         
+         @return void.
+         */
+        void storeContents(const std::string &path, const std::string &signature, const documentContents_t &contents);
+        
+        /*
+         @brief: cache the tree of a file, if its text is still cached for the same signature.
+         
+         @param `path` The path to the file.
+         @param `signature` The signature of the file when it was read.
+         @param `tree` The parsed text.
+         
+         @return void.
+         */
+        void storeTree(const std::string &path, const std::string &signature, const std::shared_ptr<const elementsTree_t> &tree);
+        
+        /*
+         @brief: look up the checked result of a document.
+         
+         @param `path` The path to the document.
+         @param `contentHash` The hash of its current contents: results of other contents are stale.
+         @param `result` Set to the cached result.
+         
+         @return bool.
+         */
+        bool lookupResult(const std::string &path, uint64_t contentHash, documentPtr_t &result);
+        
+        /*
+         @brief: cache the checked result of a document. Results should not hold the text or the
+                tree: they would stay in memory, unaccounted, as long as the result.
+         
+         @param `path` The path to the document.
+         @param `result` The result.
+         
+         @return void.
+         */
+        void storeResult(const std::string &path, const documentPtr_t &result);
+        
+        /*
+         @brief: forget everything about a file.
+         
+         @param `path` The path to the file.
+         
+         @return void.
+         */
+        void erase(const std::string &path);
+        
+        /*
+         @brief: forget the result of a document, keeping its text and tree.
+         
+         @param `path` The path to the document.
+         
+         @return void.
+         */
+        void eraseResult(const std::string &path);
+        
+        /*
+         @brief: forget every result, keeping texts and trees.
+         
+         @return void.
+         */
+        void clearResults();
+        
+        /*
+         @brief: return the path of every file with a signature, sorted.
+         
+         @return std::vector<std::string>.
+         */
+        std::vector<std::string> paths();
+        
+        documentCacheStatistics_t statistics();
+        
+    private:
+        enum tier
+        {
+            TIER_TREE,
+            TIER_TEXT,
+            TIER_RESULT,
+            TIERS_COUNT
+        };
+        
+        struct entry_t;
+        
+        typedef std::map<std::string, entry_t> entries_t;
+        typedef std::list<entries_t::iterator> lruList_t; // Most recently used first
+        
+        struct entry_t
+        {
+            std::string signature;
+            uint64_t contentHash;
+            std::shared_ptr<const std::string> plaintext;
+            std::shared_ptr<const elementsTree_t> tree;
+            documentPtr_t result;
+            
+            size_t baseBytes; // The path and the signature, never evicted
+            size_t bytes[TIERS_COUNT]; // Accounted for each tier, 0 when absent
+            lruList_t::iterator positions[TIERS_COUNT]; // Valid when the tier is present
+        };
+        
+        entries_t::iterator find(const std::string &path, const std::string &signature);
+        void touch(entries_t::iterator it, tier level);
+        void insert(entries_t::iterator it, tier level, size_t bytes);
+        void drop(entries_t::iterator it, tier level);
+        void evict();
+        
+        std::mutex mutex;
+        entries_t entries;
+        lruList_t lru[TIERS_COUNT];
+        
+        size_t budget, bytes, peakBytes;
+        size_t textHits, textMisses, treeHits, treeMisses, resultHits, resultMisses;
+        size_t evictions[TIERS_COUNT];
+    };
+}
+
+#endif /* documentCacheUtils_hpp */
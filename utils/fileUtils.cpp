@@ -26,11 +26,75 @@
  SOFTWARE.
  */
 
+#include <fcntl.h>
 #include <fstream>
 #include <sys/stat.h> //For checking if a file exists
+#include <unistd.h>
 
 #include "fileUtils.hpp"
 
+fileUtils::fileBuffer::fileBuffer(const std::string &path) : valid(false)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    
+    if (fd < 0)
+    {
+        return;
+    }
+    
+    struct stat buffer;
+    
+    if (fstat(fd, &buffer) != 0)
+    {
+        close(fd);
+        return;
+    }
+    
+    // Sized after the file: one read, unless it grew in the meantime.
+    contents.resize(buffer.st_size);
+    size_t length = 0;
+    
+    while (true)
+    {
+        if (length == contents.size())
+        {
+            contents.resize(length + 4096);
+        }
+        
+        auto count = read(fd, &contents[length], contents.size() - length);
+        
+        if (count <= 0)
+        {
+            valid = count == 0;
+            break;
+        }
+        
+        length += count;
+    }
+    
+    contents.resize(length);
+    close(fd);
+}
+
+fileUtils::fileBuffer::fileBuffer(std::string &&contents) : contents(std::move(contents)), valid(true)
+{
+}
+
+bool fileUtils::fileBuffer::isValid() const
+{
+    return valid;
+}
+
+const char *fileUtils::fileBuffer::data() const
+{
+    return contents.data();
+}
+
+size_t fileUtils::fileBuffer::size() const
+{
+    return contents.size();
+}
+
 std::string fileUtils::getParentDirectory(const std::string &path)
 {
     std::string ret = path;
@@ -55,3 +119,44 @@ bool fileUtils::doesFileExist(const std::string &path)
     struct stat buffer;
     return (stat (path.c_str(), &buffer) == 0);
 }
+
+std::string fileUtils::getFileSignature(const std::string &path)
+{
+    struct stat buffer;
+    
+    if (stat(path.c_str(), &buffer) != 0)
+    {
+        return "";
+    }
+    
+#ifdef __APPLE__
+    auto &modificationTime = buffer.st_mtimespec;
+#else
+    auto &modificationTime = buffer.st_mtim;
+#endif
+    
+    return formatFileSignature(buffer.st_size, modificationTime.tv_sec, modificationTime.tv_nsec);
+}
+
+std::string fileUtils::formatFileSignature(uint64_t size, int64_t seconds, int64_t nanoseconds)
+{
+    return std::to_string(size) + "-" + std::to_string(seconds) + "." + std::to_string(nanoseconds);
+}
+
+double fileUtils::getModificationTime(const std::string &path)
+{
+    struct stat buffer;
+    
+    if (stat(path.c_str(), &buffer) != 0)
+    {
+        return 0;
+    }
+    
+#ifdef __APPLE__
+    auto &modificationTime = buffer.st_mtimespec;
+#else
+    auto &modificationTime = buffer.st_mtim;
+#endif
+    
+    return modificationTime.tv_sec + modificationTime.tv_nsec / 1e9;
+}
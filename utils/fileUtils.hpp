@@ -29,10 +29,59 @@
 #ifndef fileUtils_hpp
 #define fileUtils_hpp
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace fileUtils
 {
+    /*
+     A copy of the bytes of a whole file, owned and read-only, read with a single read of
+     their size rather than through stream buffers. Files are not mapped: touching the
+     mapping of a file truncated in the meantime kills the process (SIGBUS). Buffers are
+     not copyable: pass them on rather than reading the file again.
+     */
+    class fileBuffer
+    {
+    public:
+        explicit fileBuffer(const std::string &path);
+        
+        /*
+         @brief: hold bytes already read, by uringUtils::readFiles for instance.
+         
+         @param `contents` The bytes of the file, moved from.
+         */
+        explicit fileBuffer(std::string &&contents);
+        
+        fileBuffer(const fileBuffer &) = delete;
+        fileBuffer &operator=(const fileBuffer &) = delete;
+        
+        /*
+         @brief: return whether the file could be read. Empty files are valid.
+         
+         @return bool.
+         */
+        bool isValid() const;
+        
+        /*
+         @brief: return the bytes of the file.
+         
+         @return const char *.
+         */
+        const char *data() const;
+        
+        /*
+         @brief: return the number of bytes of the file.
+         
+         @return size_t.
+         */
+        size_t size() const;
+        
+    private:
+        std::string contents;
+        bool valid;
+    };
+    
     /*
      @brief: given a path to a file or directory, return its parent directory.
             The existence of the file or directory at `path` is not mandatory.
@@ -51,6 +100,37 @@ namespace fileUtils
      @return bool.
      */
     bool doesFileExist(const std::string &path);
+    
+    /*
+     @brief: given a path, return a string which changes whenever the file is modified
+            (its size and modification time).
+     
+     @param `path` A path.
+     
+     @return std::string. Empty if the file does not exist.
+     */
+    std::string getFileSignature(const std::string &path);
+    
+    /*
+     @brief: return the signature of a file from its size and modification time, for callers
+            which got them without stat (see uringUtils::getFileSignatures).
+     
+     @param `size` The size of the file, in bytes.
+     @param `seconds` The modification time, in seconds since the epoch.
+     @param `nanoseconds` The fraction of the modification time, in nanoseconds.
+     
+     @return std::string.
+     */
+    std::string formatFileSignature(uint64_t size, int64_t seconds, int64_t nanoseconds);
+    
+    /*
+     @brief: given a path, return the time of its last modification.
+     
+     @param `path` A path.
+     
+     @return double. Seconds since the epoch, 0 if the file does not exist.
+     */
+    double getModificationTime(const std::string &path);
 }
 
 #endif /* fileUtils_hpp */
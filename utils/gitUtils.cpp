@@ -0,0 +1,83 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <vector>
+
+#include "gitUtils.hpp"
+#include "shellUtils.hpp"
+
+/*
+ Run git and add the NUL separated paths it prints. Return whether it succeeded.
+ */
+static bool addListedPaths(const std::vector<std::string> &arguments, std::set<std::string> &paths)
+{
+    // Git's own errors go to the terminal.
+    auto result = shellUtils::run(arguments, nullptr, 0, {false, false, 0});
+    
+    if (result.exitStatus != 0)
+    {
+        return false;
+    }
+    
+    size_t beginIdx = 0;
+    
+    while (beginIdx < result.output.length())
+    {
+        auto endIdx = result.output.find('\0', beginIdx);
+        
+        if (endIdx == std::string::npos)
+        {
+            endIdx = result.output.length();
+        }
+        
+        if (endIdx > beginIdx)
+        {
+            paths.insert("./" + result.output.substr(beginIdx, endIdx - beginIdx));
+        }
+        
+        beginIdx = endIdx + 1;
+    }
+    
+    return true;
+}
+
+bool gitUtils::getChangedFiles(const std::string &revisions, std::set<std::string> &paths)
+{
+    // --relative limits the changes to the working directory, and makes paths relative to it.
+    if (!addListedPaths({"git", "diff", "--name-only", "-z", "--no-renames", "--relative", revisions, "--"}, paths))
+    {
+        return false;
+    }
+    
+    if (revisions.find("..") != std::string::npos)
+    {
+        return true;
+    }
+    
+    return addListedPaths({"git", "ls-files", "--others", "--exclude-standard", "-z"}, paths);
+}
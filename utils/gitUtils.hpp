@@ -0,0 +1,51 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef gitUtils_hpp
+#define gitUtils_hpp
+
+#include <set>
+#include <string>
+
+namespace gitUtils
+{
+    /*
+     @brief: ask the git repository containing the working directory for the files changed
+            between revisions. Renames count as a deletion and a creation.
+     
+     @param `revisions` Either "<from>..<to>", or a single revision compared with the working
+            tree (e.g. "HEAD"), in which case untracked files count as changed too.
+     @param `paths` Filled with the changed files under the working directory, in the form of
+            the walked paths (e.g. "./a/b.html"), deleted ones included.
+     
+     @return bool. False if git failed (not a repository, unknown revision, no git).
+     */
+    bool getChangedFiles(const std::string &revisions, std::set<std::string> &paths);
+}
+
+#endif /* gitUtils_hpp */
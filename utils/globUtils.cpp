@@ -0,0 +1,322 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "globUtils.hpp"
+
+globUtils::pattern::pattern(const std::string &text) : fastPath(SHORTCUT_NONE), negated(false), directoryOnly(false), anchored(false)
+{
+    std::string body = text;
+    
+    if (body.length() > 0 && body.front() == '!')
+    {
+        negated = true;
+        body.erase(0, 1);
+    }
+    else if (body.length() > 1 && body.front() == '\\' && (body[1] == '!' || body[1] == '#'))
+    {
+        body.erase(0, 1);
+    }
+    
+    if (body.length() > 1 && body.back() == '/')
+    {
+        directoryOnly = true;
+        body.pop_back();
+    }
+    
+    // A separator anywhere but at the end binds the pattern to its directory.
+    anchored = body.find('/') != std::string::npos;
+    
+    if (body.length() > 0 && body.front() == '/')
+    {
+        body.erase(0, 1);
+    }
+    
+    for (size_t i = 0; i < body.length(); ++i)
+    {
+        char c = body[i];
+        bool wholeComponent = i == 0 || body[i - 1] == '/';
+        
+        if (c == '*' && i + 1 < body.length() && body[i + 1] == '*' && wholeComponent &&
+            (i + 2 == body.length() || body[i + 2] == '/'))
+        {
+            if (i + 2 == body.length())
+            {
+                tokens.push_back({TOKEN_ANYTHING, "", false});
+            }
+            else
+            {
+                tokens.push_back({TOKEN_ANY_DIRECTORIES, "", false});
+            }
+            
+            // The separator is part of the token.
+            i += 2;
+        }
+        else if (c == '*')
+        {
+            // Other runs of asterisks are a single one.
+            while (i + 1 < body.length() && body[i + 1] == '*')
+            {
+                ++i;
+            }
+            
+            tokens.push_back({TOKEN_ANY_CHARACTERS, "", false});
+        }
+        else if (c == '?')
+        {
+            tokens.push_back({TOKEN_ANY_CHARACTER, "", false});
+        }
+        else if (c == '[' && body.find(']', i + 2) != std::string::npos)
+        {
+            token_t token = {TOKEN_CLASS, "", false};
+            
+            ++i;
+            
+            if (body[i] == '!' || body[i] == '^')
+            {
+                token.negatedClass = true;
+                ++i;
+            }
+            
+            // A "]" right after the opening bracket is a member of the class.
+            do
+            {
+                token.text += body[i++];
+            }
+            while (i < body.length() && body[i] != ']');
+            
+            tokens.push_back(token);
+        }
+        else
+        {
+            if (c == '\\' && i + 1 < body.length())
+            {
+                c = body[++i];
+            }
+            
+            if (tokens.size() > 0 && tokens.back().type == TOKEN_LITERAL)
+            {
+                tokens.back().text += c;
+            }
+            else
+            {
+                tokens.push_back({TOKEN_LITERAL, std::string(1, c), false});
+            }
+        }
+    }
+    
+    if (tokens.size() == 1 && tokens[0].type == TOKEN_LITERAL)
+    {
+        fastPath = SHORTCUT_EQUALS;
+        literal = tokens[0].text;
+    }
+    else if (tokens.size() == 2 && tokens[0].type == TOKEN_ANY_CHARACTERS && tokens[1].type == TOKEN_LITERAL &&
+             tokens[1].text.find('/') == std::string::npos)
+    {
+        fastPath = SHORTCUT_SUFFIX;
+        literal = tokens[1].text;
+    }
+}
+
+bool globUtils::pattern::matchClass(const token_t &token, char c)
+{
+    bool found = false;
+    auto &members = token.text;
+    
+    for (size_t i = 0; i < members.length() && !found; ++i)
+    {
+        if (i + 2 < members.length() && members[i + 1] == '-')
+        {
+            found = c >= members[i] && c <= members[i + 2];
+            i += 2;
+        }
+        else
+        {
+            found = c == members[i];
+        }
+    }
+    
+    return found != token.negatedClass && c != '/';
+}
+
+bool globUtils::pattern::matchTokens(size_t tokenIdx, const std::string &text, size_t textIdx) const
+{
+    for (; tokenIdx < tokens.size(); ++tokenIdx)
+    {
+        auto &token = tokens[tokenIdx];
+        
+        switch (token.type)
+        {
+            case TOKEN_LITERAL:
+                if (text.compare(textIdx, token.text.length(), token.text) != 0)
+                {
+                    return false;
+                }
+                
+                textIdx += token.text.length();
+                break;
+                
+            case TOKEN_ANY_CHARACTER:
+            case TOKEN_CLASS:
+                if (textIdx >= text.length() || text[textIdx] == '/' ||
+                    (token.type == TOKEN_CLASS && !matchClass(token, text[textIdx])))
+                {
+                    return false;
+                }
+                
+                ++textIdx;
+                break;
+                
+            case TOKEN_ANY_CHARACTERS:
+                // Try every length up to the next separator, longest last.
+                for (size_t end = textIdx; ; ++end)
+                {
+                    if (matchTokens(tokenIdx + 1, text, end))
+                    {
+                        return true;
+                    }
+                    
+                    if (end >= text.length() || text[end] == '/')
+                    {
+                        return false;
+                    }
+                }
+                
+            case TOKEN_ANY_DIRECTORIES:
+                // Zero or more whole components.
+                for (size_t start = textIdx; start <= text.length(); start = text.find('/', start) + 1)
+                {
+                    if (matchTokens(tokenIdx + 1, text, start))
+                    {
+                        return true;
+                    }
+                    
+                    if (text.find('/', start) == std::string::npos)
+                    {
+                        return false;
+                    }
+                }
+                
+                return false;
+                
+            case TOKEN_ANYTHING:
+                // Everything inside, not the directory itself.
+                return textIdx < text.length();
+        }
+    }
+    
+    return textIdx == text.length();
+}
+
+bool globUtils::pattern::matches(const std::string &relativePath, const std::string &name, bool isDirectory) const
+{
+    if (directoryOnly && !isDirectory)
+    {
+        return false;
+    }
+    
+    auto &text = anchored ? relativePath : name;
+    
+    switch (fastPath)
+    {
+        case SHORTCUT_EQUALS:
+            return text.compare(literal) == 0;
+            
+        case SHORTCUT_SUFFIX:
+            // "*" does not cross "/": anchored patterns like "/*.html" only match at their level.
+            return text.length() >= literal.length() && text.compare(text.length() - literal.length(), literal.length(), literal) == 0 &&
+                text.find('/') == std::string::npos;
+            
+        case SHORTCUT_NONE:
+            return matchTokens(0, text, 0);
+    }
+    
+    return false;
+}
+
+bool globUtils::pattern::isNegated() const
+{
+    return negated;
+}
+
+void globUtils::ruleSet::add(const std::string &line)
+{
+    std::string text = line;
+    
+    if (text.length() > 0 && text.back() == '\r')
+    {
+        text.pop_back();
+    }
+    
+    while (text.length() > 0 && text.back() == ' ' && (text.length() < 2 || text[text.length() - 2] != '\\'))
+    {
+        text.pop_back();
+    }
+    
+    if (text.length() == 0 || text.front() == '#')
+    {
+        return;
+    }
+    
+    patterns.push_back(pattern(text));
+}
+
+void globUtils::ruleSet::addLines(const std::string &contents)
+{
+    size_t beginIdx = 0;
+    
+    while (beginIdx < contents.length())
+    {
+        auto endIdx = contents.find('\n', beginIdx);
+        
+        if (endIdx == std::string::npos)
+        {
+            endIdx = contents.length();
+        }
+        
+        add(contents.substr(beginIdx, endIdx - beginIdx));
+        beginIdx = endIdx + 1;
+    }
+}
+
+globMatch globUtils::ruleSet::match(const std::string &relativePath, const std::string &name, bool isDirectory) const
+{
+    for (auto it = patterns.rbegin(); it != patterns.rend(); ++it)
+    {
+        if (it->matches(relativePath, name, isDirectory))
+        {
+            return it->isNegated() ? GLOB_NEGATED_MATCH : GLOB_MATCH;
+        }
+    }
+    
+    return GLOB_NO_MATCH;
+}
+
+bool globUtils::ruleSet::empty() const
+{
+    return patterns.empty();
+}
@@ -0,0 +1,161 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef globUtils_hpp
+#define globUtils_hpp
+
+#include <string>
+#include <vector>
+
+enum globMatch
+{
+    GLOB_NO_MATCH,
+    GLOB_MATCH, // Matched by a pattern
+    GLOB_NEGATED_MATCH // Matched by a "!" pattern
+};
+
+namespace globUtils
+{
+    /*
+     A glob pattern with .gitignore semantics, compiled once:
+     - "*" and "?" do not match "/", "[a-z]" and "[!a-z]" match a character class;
+     - "**" matches any number of directories when it is a whole component ("**" + "/",
+       "/" + "**" + "/", "/" + "**"), otherwise it is a "*";
+     - patterns without "/" (but a trailing one) match the name at any depth, the others
+       the path relative to the directory of the pattern, even with a leading "/";
+     - a trailing "/" only matches directories, a leading "!" negates the pattern.
+     Patterns like "*.html" or "node_modules" are recognized and matched without the
+     general matcher.
+     */
+    class pattern
+    {
+    public:
+        explicit pattern(const std::string &text);
+        
+        /*
+         @brief: return whether the pattern matches a path.
+         
+         @param `relativePath` The path, relative to the directory of the pattern, without leading "./".
+         @param `name` The last component of the path.
+         @param `isDirectory` Whether the path is a directory.
+         
+         @return bool.
+         */
+        bool matches(const std::string &relativePath, const std::string &name, bool isDirectory) const;
+        
+        /*
+         @brief: return whether the pattern started with "!".
+         
+         @return bool.
+         */
+        bool isNegated() const;
+        
+    private:
+        enum tokenType
+        {
+            TOKEN_LITERAL,
+            TOKEN_ANY_CHARACTER, // ?
+            TOKEN_ANY_CHARACTERS, // *
+            TOKEN_ANY_DIRECTORIES, // ** followed by /, matches zero or more whole components
+            TOKEN_ANYTHING, // Trailing **
+            TOKEN_CLASS
+        };
+        
+        struct token_t
+        {
+            tokenType type;
+            std::string text; // Literal, or the characters (and "a-z" ranges) of a class
+            bool negatedClass;
+        };
+        
+        enum shortcut
+        {
+            SHORTCUT_NONE,
+            SHORTCUT_EQUALS, // Literal pattern
+            SHORTCUT_SUFFIX // "*" followed by a literal
+        };
+        
+        bool matchTokens(size_t tokenIdx, const std::string &text, size_t textIdx) const;
+        static bool matchClass(const token_t &token, char c);
+        
+        std::vector<token_t> tokens;
+        shortcut fastPath;
+        std::string literal; // For the shortcuts
+        bool negated, directoryOnly, anchored;
+    };
+    
+    /*
+     The patterns of an ignore file (or of the command line), in order: as in .gitignore,
+     the last pattern matching a path decides.
+     */
+    class ruleSet
+    {
+    public:
+        /*
+         @brief: add a pattern. Blank lines and comments ("#") are ignored, trailing spaces
+                are trimmed unless escaped, and "\#" or "\!" stand for a literal first character.
+         
+         @param `line` A line of an ignore file.
+         
+         @return void.
+         */
+        void add(const std::string &line);
+        
+        /*
+         @brief: add every line of an ignore file's contents.
+         
+         @param `contents` The contents of the file.
+         
+         @return void.
+         */
+        void addLines(const std::string &contents);
+        
+        /*
+         @brief: return which kind of pattern matches a path last, if any.
+         
+         @param `relativePath` The path, relative to the directory of the patterns.
+         @param `name` The last component of the path.
+         @param `isDirectory` Whether the path is a directory.
+         
+         @return globMatch.
+         */
+        globMatch match(const std::string &relativePath, const std::string &name, bool isDirectory) const;
+        
+        /*
+         @brief: return whether the rule set holds no pattern.
+         
+         @return bool.
+         */
+        bool empty() const;
+        
+    private:
+        std::vector<pattern> patterns;
+    };
+}
+
+#endif /* globUtils_hpp */
@@ -0,0 +1,155 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <cstring>
+
+#include "hashUtils.hpp"
+
+/*
+ Source: https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+ */
+
+static const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+static const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// memcpy instead of a cast: the input is not necessarily aligned.
+static inline uint64_t read64(const char *data)
+{
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read32(const char *data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint64_t accumulate(uint64_t accumulator, uint64_t lane)
+{
+    accumulator += lane * kPrime2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * kPrime1;
+}
+
+static inline uint64_t mergeRound(uint64_t accumulator, uint64_t lane)
+{
+    accumulator ^= accumulate(0, lane);
+    return accumulator * kPrime1 + kPrime4;
+}
+
+uint64_t hashUtils::hash64(const char *data, size_t length)
+{
+    const char *end = data + length;
+    uint64_t hash;
+    
+    if (length >= 32)
+    {
+        uint64_t v1 = kPrime1 + kPrime2;
+        uint64_t v2 = kPrime2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - kPrime1;
+        
+        // Four independent lanes of 8 bytes each, to keep the cpu pipelines busy.
+        for (; data + 32 <= end; data += 32)
+        {
+            v1 = accumulate(v1, read64(data));
+            v2 = accumulate(v2, read64(data + 8));
+            v3 = accumulate(v3, read64(data + 16));
+            v4 = accumulate(v4, read64(data + 24));
+        }
+        
+        hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    }
+    else
+    {
+        hash = kPrime5;
+    }
+    
+    hash += length;
+    
+    for (; data + 8 <= end; data += 8)
+    {
+        hash ^= accumulate(0, read64(data));
+        hash = rotateLeft(hash, 27) * kPrime1 + kPrime4;
+    }
+    
+    if (data + 4 <= end)
+    {
+        hash ^= read32(data) * kPrime1;
+        hash = rotateLeft(hash, 23) * kPrime2 + kPrime3;
+        data += 4;
+    }
+    
+    for (; data < end; ++data)
+    {
+        hash ^= static_cast<unsigned char>(*data) * kPrime5;
+        hash = rotateLeft(hash, 11) * kPrime1;
+    }
+    
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    
+    return hash;
+}
+
+uint64_t hashUtils::hash64(const std::string &data)
+{
+    return hashUtils::hash64(data.data(), data.length());
+}
+
+std::string hashUtils::toHex(uint64_t hash)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string ret(16, '0');
+    
+    for (int i = 15; i >= 0; --i)
+    {
+        ret[i] = digits[hash & 0xF];
+        hash >>= 4;
+    }
+    
+    return ret;
+}
@@ -0,0 +1,65 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef hashUtils_hpp
+#define hashUtils_hpp
+
+#include <cstdint>
+#include <string>
+
+namespace hashUtils
+{
+    /*
+     @brief: given some bytes, return their 64 bits XXH64 hash. Not cryptographic, but
+            fast (several GB/s) and well distributed: good to detect changed contents.
+     
+     @param `data` The bytes to hash.
+     @param `length` The number of bytes to hash.
+     
+     @return uint64_t.
+     */
+    uint64_t hash64(const char *data, size_t length);
+    
+    /*
+     @brief: same as above, for a whole string.
+     
+     @return uint64_t.
+     */
+    uint64_t hash64(const std::string &data);
+    
+    /*
+     @brief: return the hexadecimal representation of a hash, zero padded to 16 characters.
+     
+     @param `hash` A hash.
+     
+     @return std::string.
+     */
+    std::string toHex(uint64_t hash);
+}
+
+#endif /* hashUtils_hpp */
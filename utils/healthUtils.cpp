@@ -0,0 +1,235 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+
+#include "curlUtils.hpp"
+#include "healthUtils.hpp"
+
+// How long a probed (or observed) status is trusted.
+#define kStatusTimeToLive 120.0
+
+// Background probes start this long before the cached status expires.
+#define kRefreshMargin 30.0
+
+// Consecutive failed requests opening the breaker, and how long it stays open.
+#define kFailureThreshold 5
+#define kOpenSeconds 30.0
+
+typedef std::chrono::steady_clock steadyClock_t;
+
+static double secondsSince(steadyClock_t::time_point time)
+{
+    return std::chrono::duration<double>(steadyClock_t::now() - time).count();
+}
+
+/*
+ Given the status line of a HEAD request (or curl's error), return the status of the endpoint.
+ */
+static endpointStatus parseStatusLine(const std::string &statusLine)
+{
+    if (statusLine.find("curl: (") != std::string::npos)
+    {
+        return ENDPOINT_UNREACHABLE;
+    }
+    
+    // "HTTP/1.1 200 OK", "HTTP/2 403"
+    auto spaceIdx = statusLine.find(' ');
+    int httpStatus = spaceIdx == std::string::npos ? 0 : std::atoi(statusLine.c_str() + spaceIdx + 1);
+    
+    if (httpStatus == 403 || httpStatus == 429)
+    {
+        return ENDPOINT_THROTTLED;
+    }
+    
+    return httpStatus > 0 && httpStatus < 400 ? ENDPOINT_HEALTHY : ENDPOINT_UNREACHABLE;
+}
+
+healthUtils::endpointHealth::endpointHealth(const std::string &url) : url(url), cachedStatus(ENDPOINT_UNKNOWN), probing(false), stats(), consecutiveFailures(0), trialInFlight(false)
+{
+    stats.state = BREAKER_CLOSED;
+}
+
+healthUtils::endpointHealth::~endpointHealth()
+{
+    if (probeThread.joinable())
+    {
+        probeThread.join();
+    }
+}
+
+endpointStatus healthUtils::endpointHealth::status()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    
+    if (cachedStatus != ENDPOINT_UNKNOWN && secondsSince(checkedAt) < kStatusTimeToLive)
+    {
+        return cachedStatus;
+    }
+    
+    // A probe already on it (e.g. a background one) is as good as a new one.
+    if (!probing)
+    {
+        startProbe();
+    }
+    
+    probed.wait(lock, [this]() {
+        return !probing;
+    });
+    
+    return cachedStatus;
+}
+
+void healthUtils::endpointHealth::refresh()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    if (probing || (cachedStatus != ENDPOINT_UNKNOWN && secondsSince(checkedAt) < kStatusTimeToLive - kRefreshMargin))
+    {
+        return;
+    }
+    
+    startProbe();
+}
+
+void healthUtils::endpointHealth::startProbe()
+{
+    // Called with the lock held, when no probe is in progress: the former thread is done.
+    if (probeThread.joinable())
+    {
+        probeThread.join();
+    }
+    
+    probing = true;
+    probeThread = std::thread([this]() {
+        setStatus(parseStatusLine(curlUtils::probeWebsite(url)));
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        probing = false;
+        probed.notify_all();
+    });
+}
+
+void healthUtils::endpointHealth::setStatus(endpointStatus newStatus)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    cachedStatus = newStatus;
+    checkedAt = steadyClock_t::now();
+    
+    // The breaker is left as is: an overloaded service often still answers probes while
+    // failing actual requests, so only the end of the cool down half-opens it (see allowRequest).
+}
+
+bool healthUtils::endpointHealth::allowRequest()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    if (stats.state == BREAKER_OPEN && secondsSince(openedAt) >= kOpenSeconds)
+    {
+        stats.state = BREAKER_HALF_OPEN;
+    }
+    
+    if (stats.state == BREAKER_CLOSED)
+    {
+        return true;
+    }
+    
+    if (stats.state == BREAKER_HALF_OPEN && !trialInFlight)
+    {
+        trialInFlight = true;
+        return true;
+    }
+    
+    ++stats.rejected;
+    return false;
+}
+
+void healthUtils::endpointHealth::recordSuccess()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    consecutiveFailures = 0;
+    trialInFlight = false;
+    stats.state = BREAKER_CLOSED;
+    
+    // Real answers are as good as a probe.
+    cachedStatus = ENDPOINT_HEALTHY;
+    checkedAt = steadyClock_t::now();
+}
+
+void healthUtils::endpointHealth::recordFailure()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    ++consecutiveFailures;
+    
+    if (trialInFlight || (stats.state == BREAKER_CLOSED && consecutiveFailures >= kFailureThreshold))
+    {
+        trialInFlight = false;
+        stats.state = BREAKER_OPEN;
+        openedAt = steadyClock_t::now();
+        ++stats.opened;
+        
+        // Probe again before the trial request instead of trusting an old healthy status.
+        cachedStatus = ENDPOINT_UNKNOWN;
+    }
+}
+
+void healthUtils::endpointHealth::abandonRequest()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    // Let another trial through.
+    trialInFlight = false;
+}
+
+breakerStatistics_t healthUtils::endpointHealth::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+healthUtils::endpointHealth &healthUtils::monitor(const std::string &url)
+{
+    static std::mutex monitorsMutex;
+    static std::map<std::string, std::unique_ptr<endpointHealth>> monitors;
+    
+    std::lock_guard<std::mutex> lock(monitorsMutex);
+    
+    auto &health = monitors[url];
+    
+    if (!health)
+    {
+        health.reset(new endpointHealth(url));
+    }
+    
+    return *health;
+}
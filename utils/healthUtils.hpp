@@ -0,0 +1,160 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef healthUtils_hpp
+#define healthUtils_hpp
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+enum endpointStatus
+{
+    ENDPOINT_UNKNOWN,
+    ENDPOINT_HEALTHY,
+    ENDPOINT_THROTTLED, // Answered 403 or 429: we sent too much
+    ENDPOINT_UNREACHABLE
+};
+
+enum breakerState
+{
+    BREAKER_CLOSED, // Requests go through
+    BREAKER_OPEN, // Requests fail fast
+    BREAKER_HALF_OPEN // A single trial request decides whether to close again
+};
+
+struct breakerStatistics_t
+{
+    breakerState state;
+    size_t opened; // Times the breaker opened
+    size_t rejected; // Requests failed fast
+};
+
+namespace healthUtils
+{
+    /*
+     The health of a remote endpoint, shared by all the runs of the program.
+     The status is probed with a single request when first needed, then cached for a while,
+     and refreshed in the background between runs. A circuit breaker watches the actual requests: after repeated
+     failures it opens and rejects the following requests right away, then half-opens after
+     a cool down to let a single trial request through.
+     */
+    class endpointHealth
+    {
+    public:
+        explicit endpointHealth(const std::string &url);
+        ~endpointHealth();
+        
+        /*
+         @brief: return the status of the endpoint. Probes it (or waits for the probe in
+                progress) only if the cached status expired. Safe to call concurrently: a
+                single probe is sent.
+         
+         @return endpointStatus.
+         */
+        endpointStatus status();
+        
+        /*
+         @brief: probe the endpoint on a background thread if the cached status will expire
+                soon, so that the next call to status() does not wait. Never blocks.
+         
+         @return void.
+         */
+        void refresh();
+        
+        /*
+         @brief: return whether a request may be sent. Once true is returned, the outcome
+                must be reported with recordSuccess() or recordFailure(). Safe to call concurrently.
+         
+         @return bool. False if the breaker is open.
+         */
+        bool allowRequest();
+        
+        /*
+         @brief: report a request answered properly. Closes the breaker.
+         
+         @return void.
+         */
+        void recordSuccess();
+        
+        /*
+         @brief: report a failed request (no answer, throttling, server error).
+                Opens the breaker after too many consecutive ones, or after a failed trial.
+         
+         @return void.
+         */
+        void recordFailure();
+        
+        /*
+         @brief: report a request which got no proper answer for reasons unrelated to the
+                endpoint (e.g. the run was cancelled). Leaves the breaker as is.
+         
+         @return void.
+         */
+        void abandonRequest();
+        
+        /*
+         @brief: return the state and history of the circuit breaker.
+         
+         @return breakerStatistics_t.
+         */
+        breakerStatistics_t statistics() const;
+        
+    private:
+        void startProbe();
+        void setStatus(endpointStatus newStatus);
+        
+        std::string url;
+        
+        mutable std::mutex mutex;
+        endpointStatus cachedStatus;
+        std::chrono::steady_clock::time_point checkedAt;
+        std::thread probeThread;
+        std::condition_variable probed;
+        bool probing;
+        
+        breakerStatistics_t stats;
+        size_t consecutiveFailures;
+        bool trialInFlight;
+        std::chrono::steady_clock::time_point openedAt;
+    };
+    
+    /*
+     @brief: return the health of the endpoint at `url`. The same object is returned for the
+            same url during the whole life of the program.
+     
+     @param `url` The url of the endpoint.
+     
+     @return endpointHealth &.
+     */
+    endpointHealth &monitor(const std::string &url);
+}
+
+#endif /* healthUtils_hpp */
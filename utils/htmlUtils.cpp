@@ -26,16 +26,21 @@
  SOFTWARE.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <thread> //Use multithreading to drastically lower parse times
 
-#include "curlUtils.hpp"
+#include "cacheUtils.hpp"
+#include "cancelUtils.hpp"
 #include "fileUtils.hpp"
 #include "htmlUtils.hpp"
-#include "json.hpp"
 #include "stringUtils.hpp"
+#include "threadUtils.hpp"
 #include "urlUtils.hpp"
-
-using json = nlohmann::json;
+#include "validatorUtils.hpp"
 
 /*
  ###############################################################################
@@ -163,6 +168,98 @@ static std::string getContents(const std::string &html, ssize_t &beginIdx, const
     return result;
 }
 
+static std::string getLinkUrl(const elementData &link)
+{
+    if (link.attributes.count("href") > 0)
+    {
+        // for links
+        return link.attributes.at("href");
+    }
+    
+    if (link.attributes.count("src") > 0)
+    {
+        // for images
+        return link.attributes.at("src");
+    }
+    
+    // Something's wrong...
+    return "";
+}
+
+static problem_t statusProblem(const std::string &type, const std::string &message)
+{
+    problem_t problem;
+    
+    problem.type = type;
+    problem.message = message;
+    problem.extract = "";
+    problem.firstLine = -1;
+    problem.firstColumn = -1;
+    problem.lastLine = -1;
+    problem.lastColumn = -1;
+    
+    return problem;
+}
+
+/*
+ The state of a document's validation, shared by the tasks checking it.
+ */
+struct pendingValidation_t
+{
+    elementsTree_t links;
+    std::vector<std::vector<problem_t>> linkProblems;
+    std::atomic<bool> linksSkipped;
+    
+    validationResult_t validatorResult;
+    bool validatorSkipped;
+    
+    std::atomic<size_t> remainingParts;
+};
+
+static void finishValidation(const pendingValidation_t &validation, document_t &document)
+{
+    for (auto &problems : validation.linkProblems)
+    {
+        document.problems.insert(document.problems.end(), problems.begin(), problems.end());
+    }
+    
+    if (validation.linksSkipped)
+    {
+        document.problems.push_back(statusProblem("timeout", "validation cancelled before all links were checked"));
+    }
+    
+    if (validation.validatorSkipped)
+    {
+        document.problems.push_back(statusProblem("timeout", "validation cancelled before the document was sent to the validator"));
+    }
+    else if (validation.validatorResult.status == VALIDATION_TIMED_OUT)
+    {
+        document.problems.push_back(statusProblem("timeout", "validator timed out"));
+    }
+    else if (validation.validatorResult.status == VALIDATION_DEFERRED)
+    {
+        document.problems.push_back(statusProblem("deferred", "not sent to the validator: request budget exhausted, deferred to a later run"));
+    }
+    else if (validation.validatorResult.status == VALIDATION_FAILED)
+    {
+        // Used to pass for a document without problems.
+        document.problems.push_back(statusProblem("unavailable", "no usable answer from the validator (empty, truncated or unparseable)"));
+    }
+    else if (validation.validatorResult.status == VALIDATION_UNAVAILABLE)
+    {
+        document.problems.push_back(statusProblem("unavailable", "not sent to the validator: it is unreachable or failed repeatedly, retrying later"));
+    }
+    else if (validation.validatorResult.status == VALIDATION_THROTTLED)
+    {
+        document.problems.push_back(statusProblem("unavailable", "not sent to the validator: too many files were sent to it, retrying later"));
+    }
+    else
+    {
+        auto &problems = validation.validatorResult.problems;
+        document.problems.insert(document.problems.end(), problems.begin(), problems.end());
+    }
+}
+
 /*
  End static, private methods.
  ###############################################################################
@@ -258,44 +355,39 @@ std::string htmlUtils::getMetaAuthor(const elementsTree_t &tree)
     return authorElement.attributes.count("content") > 0 ? authorElement.attributes["content"] : "";
 }
 
-void htmlUtils::validateLink(const elementData &link, const std::string &pwd, const std::string &path, document_t &document)
+void htmlUtils::validateLink(const elementData &link, const std::string &pwd, const std::string &path, const document_t &document, std::vector<problem_t> &problems)
 {
-    std::string href = "";
+    std::string href = getLinkUrl(link);
     
-    if (link.attributes.count("href") > 0)
-    {
-        // for links
-        href = link.attributes.at("href");
-    }
-    else if (link.attributes.count("src") > 0)
-    {
-        // for images
-        href = link.attributes.at("src");
-    }
-    else
-    {
-        // Something's wrong...
-    }
+    auto state = urlUtils::checkUrlRelativeToPath(href, pwd + "/" + fileUtils::getParentDirectory(path), *document.tree);
     
-    if (!urlUtils::isUrlValidRelativeToPath(href, pwd + "/" + fileUtils::getParentDirectory(path), document.tree))
+    if (state != URL_VALID)
     {
         problem_t problem;
         
-        problem.type = "error";
-        problem.message = "broken link";
+        // A timed out link is not necessarily broken: keep it apart so it can be rechecked.
+        problem.type = state == URL_TIMED_OUT ? "timeout" : "error";
+        problem.message = state == URL_TIMED_OUT ? "link timed out" : "broken link";
         problem.extract = href;
-        problem.firstLine = stringUtils::firstLineOccurrence(document.plaintext, link.stringRepresentation);
-        
-        static std::mutex writeMutex;
-        writeMutex.lock();
-        
-        document.problems.push_back(problem);
+        problem.firstLine = stringUtils::firstLineOccurrence(*document.plaintext, link.stringRepresentation);
+        problem.firstColumn = -1;
+        problem.lastLine = -1;
+        problem.lastColumn = -1;
         
-        writeMutex.unlock();
+        problems.push_back(problem);
     }
 }
 
-void htmlUtils::validateHtml(const std::string &path, const std::string &pwd, document_t &document)
+void htmlUtils::validateHtml(const std::string &path, const std::string &pwd, document_t &document, threadUtils::taskGroup &group)
+{
+    group.add();
+    
+    htmlUtils::validateHtml(path, pwd, document, [&group]() {
+        group.done();
+    });
+}
+
+void htmlUtils::validateHtml(const std::string &path, const std::string &pwd, document_t &document, const task_t &completion)
 {
     // Check author
     if (document.author.compare("") == 0)
@@ -316,121 +408,98 @@ void htmlUtils::validateHtml(const std::string &path, const std::string &pwd, do
     }
     
     // Inspect links
-    auto links = htmlUtils::extractElementsMatchingPatternFromTree(document.tree, "a", {{"href", ""}}); // Look for href, just in case some links don't have it...
-    auto images = htmlUtils::extractElementsMatchingPatternFromTree(document.tree, "img", {{"src", ""}}); // Look for href, just in case some links don't have it...
+    auto links = htmlUtils::extractElementsMatchingPatternFromTree(*document.tree, "a", {{"href", ""}}); // Look for href, just in case some links don't have it...
+    auto images = htmlUtils::extractElementsMatchingPatternFromTree(*document.tree, "img", {{"src", ""}}); // Look for href, just in case some links don't have it...
     
     links.insert(links.end(), images.begin(), images.end());
     
-    /*
-     // TODO: why does this sometimes fail to validate some links?
-    // Check links in multiple threads because speed is cool.
-    std::vector<std::thread>threads;
+    // Record the local files linked to: changing one of them checks this document again.
+    std::set<std::string> linkTargets;
     
     for (auto &link : links)
     {
-        threads.push_back(std::thread(&htmlUtils::validateLink, std::ref(link), pwd, path, std::ref(document)));
+        auto target = urlUtils::resolveLocalPath(getLinkUrl(link), path);
+        
+        if (target.length() > 0)
+        {
+            linkTargets.insert(target);
+        }
     }
     
-    for (auto &thread : threads)
+    cacheUtils::setLinks(path, linkTargets);
+    
+    // Files linked to for the first time are checked as they are now: see cacheUtils::setSignature.
+    for (auto &target : linkTargets)
     {
-        thread.join();
-    }*/
+        std::string signature;
+        
+        if (!cacheUtils::getSignature(target, signature))
+        {
+            cacheUtils::setSignature(target, fileUtils::getFileSignature(target));
+        }
+    }
     
+    // Report links in the order they appear in the document, not grouped by tag.
+    std::vector<std::pair<size_t, size_t>> linksOrder; // Offset in the document, index in `links`
     
-    for (auto &link : links)
+    for (size_t i = 0; i < links.size(); ++i)
     {
-        validateLink(link, pwd, path, document);
+        linksOrder.push_back({document.plaintext->find(links[i].stringRepresentation), i});
     }
-
-    std::string response = curlUtils::validateHTML(path);
     
-    if (response.length() == 0)
+    std::sort(linksOrder.begin(), linksOrder.end());
+    
+    // Links and the validator are checked concurrently, and nothing waits for them: the last
+    // one to complete merges the results (see finishValidation).
+    // Bug fix: the old version captured loop references into threads and shared a static
+    // mutex. Each link check now owns the buffer it writes to, and buffers are merged in order.
+    auto validation = std::make_shared<pendingValidation_t>();
+    
+    for (auto &linkOrder : linksOrder)
     {
-        return;
+        validation->links.push_back(links[linkOrder.second]);
     }
     
-    json result = json::parse(response);
+    validation->linkProblems.resize(links.size());
+    validation->linksSkipped = false;
+    validation->validatorSkipped = false;
+    validation->remainingParts = links.size() + 1;
     
-    if (result.count("messages") > 0)
-    {
-        for (auto &message : result["messages"])
+    auto partDone = [validation, &document, completion]() {
+        if (--validation->remainingParts == 0)
         {
-            problem_t problem;
-            
-            if (message.count("type") > 0)
-            {
-                problem.type = message["type"];
-            }
-            else
-            {
-                problem.type = "unknown";
-            }
-            
-            if (message.count("message") > 0)
-            {
-                problem.message = message["message"];
-            }
-            else
-            {
-                problem.message = "No message";
-            }
-            
-            if (message.count("extract") > 0)
-            {
-                problem.extract = message["extract"];
-            }
-            else
-            {
-                problem.extract = "No extract";
-            }
-            
-            if (message.count("lastLine") > 0)
-            {
-                problem.lastLine = message["lastLine"];
-            }
-            else
-            {
-                problem.lastLine = -1;
-            }
-            
-            if (message.count("lastColumn") > 0)
-            {
-                problem.lastColumn = message["lastColumn"];
-            }
-            else
-            {
-                problem.lastColumn = -1;
-            }
-            
-            if (message.count("firstLine") > 0)
-            {
-                problem.firstLine = message["firstLine"];
-            }
-            else
-            {
-                problem.firstLine = problem.lastLine;
-            }
-            
-            if (message.count("firstColumn") > 0)
+            finishValidation(*validation, document);
+            completion();
+        }
+    };
+    
+    // Check links in parallel, on the I/O pool since most of them are network requests.
+    for (size_t i = 0; i < links.size(); ++i)
+    {
+        threadUtils::ioPool().submit([validation, i, &pwd, &path, &document, partDone]() {
+            if (cancelUtils::isCancelled())
             {
-                problem.firstColumn = message["firstColumn"];
+                validation->linksSkipped = true;
             }
             else
             {
-                problem.firstColumn = problem.lastColumn;
+                htmlUtils::validateLink(validation->links[i], pwd, path, document, validation->linkProblems[i]);
             }
             
-            document.problems.push_back(problem);
-        }
+            partDone();
+        });
     }
     
-    static std::mutex writeMutex;
-    static ssize_t filesCount = 0;
-    
-    writeMutex.lock();
-    
-    ++filesCount;
-    std::cout << "\r" << "Validating files: " << filesCount << std::flush;
+    if (cancelUtils::isCancelled())
+    {
+        validation->validatorSkipped = true;
+        partDone();
+        return;
+    }
     
-    writeMutex.unlock();
+    // Unchanged contents never need to be sent again, whatever their path.
+    validatorUtils::validateDocument(path, document, [validation, partDone](const validationResult_t &result) {
+        validation->validatorResult = result;
+        partDone();
+    });
 }
@@ -29,10 +29,15 @@
 #ifndef htmlUtils_hpp
 #define htmlUtils_hpp
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_map> //Order not important -> unordered_map is faster than map
 #include <vector>
 
+#include "fileUtils.hpp"
+#include "threadUtils.hpp"
+
 typedef std::unordered_map<std::string, std::string> attributesMap_t;
 
 struct elementData
@@ -52,14 +57,22 @@ struct problem_t
     ssize_t firstLine, firstColumn, lastLine, lastColumn;
 };
 
+/*
+ The text and the tree are immutable once read and parsed, and shared by every copy of the
+ document: copies only own their problems.
+ */
 struct document_t
 {
     std::string author;
-    std::string plaintext;
-    elementsTree_t tree;
+    std::shared_ptr<const std::string> plaintext;
+    uint64_t contentHash; //Hash of the file's bytes, as sent to the validator
+    std::shared_ptr<const fileUtils::fileBuffer> file; //Those very bytes, while they may be sent (see validatorUtils::needsFile)
+    std::shared_ptr<const elementsTree_t> tree;
     std::vector<problem_t> problems;
 };
 
+typedef std::shared_ptr<const document_t> documentPtr_t;
+
 namespace htmlUtils
 {
     /*
@@ -99,15 +112,38 @@ namespace htmlUtils
     std::string getMetaAuthor(const elementsTree_t &tree);
     
     
-    void validateLink(const elementData &link, const std::string &pwd, const std::string &path, document_t &document);
+    /**
+     Check that a link (or an image) points to an existing resource.
+     Safe to call concurrently for the same document.
+
+     @param link The <a> or <img> element
+     @param pwd The directory of the executable
+     @param path A path to the html document containing the link
+     @param document The document containing the link
+     @param problems Where to append the problem found, if any
+     */
+    void validateLink(const elementData &link, const std::string &pwd, const std::string &path, const document_t &document, std::vector<problem_t> &problems);
     
     /**
-     Validate an html document
+     Validate an html document. Its links and its contents are checked asynchronously:
+     the problems are added to the document once `group` is done.
 
      @param path A path to the html document
-     @param document A document containing the html data
+     @param pwd The directory of the executable
+     @param document A document containing the html data. Must stay valid until `group` is done.
+     @param group The task group tracking the validation
+     */
+    void validateHtml(const std::string &path, const std::string &pwd, document_t &document, threadUtils::taskGroup &group);
+    
+    /**
+     Validate an html document, as above, calling `completion` once the problems were added.
+     
+     @param path A path to the html document. Must stay valid until `completion` is called.
+     @param pwd The directory of the executable. Must stay valid until `completion` is called.
+     @param document A document containing the html data. Must stay valid until `completion` is called.
+     @param completion Called once, from any thread, when the validation is complete
      */
-    void validateHtml(const std::string &path, const std::string &pwd, document_t &document);
+    void validateHtml(const std::string &path, const std::string &pwd, document_t &document, const task_t &completion);
 }
 
 #endif /* htmlUtils_hpp */
@@ -0,0 +1,401 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "cancelUtils.hpp"
+#include "indexUtils.hpp"
+
+#ifdef __linux__
+// Events read per system call.
+#define kEventBufferSize 65536
+
+// Directory changes which keep the list of files up to date.
+#define kWatchMask (IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#endif
+
+static std::mutex indexMutex;
+static std::string indexRoot = ".";
+static walkOptions_t indexOptions;
+static std::set<std::string> indexedFiles;
+static bool stale = true;
+static indexStatistics_t stats = {};
+
+// Changes since the last snapshot, for waitForChanges.
+static std::condition_variable changesCondition;
+static std::set<std::string> changedFiles;
+static std::set<std::string> changedOtherFiles; // Outside of the index: images, style sheets...
+static std::chrono::steady_clock::time_point lastChangeAt;
+
+#ifdef __linux__
+static int inotifyFd = -1;
+static int wakePipe[2] = {-1, -1};
+static std::map<int, std::string> watchedDirectories; // Watch descriptor to path
+static std::thread watcherThread;
+#endif
+
+static bool sameOptions(const walkOptions_t &a, const walkOptions_t &b)
+{
+    return a.includePatterns == b.includePatterns && a.excludePatterns == b.excludePatterns && a.ignoreFiles == b.ignoreFiles;
+}
+
+/*
+ Walk the tree again and watch its directories. indexMutex must be held.
+ */
+static void rebuild()
+{
+    std::mutex walkMutex;
+    std::set<std::string> files;
+    
+#ifdef __linux__
+    for (auto &watched : watchedDirectories)
+    {
+        inotify_rm_watch(inotifyFd, watched.first);
+    }
+    
+    watchedDirectories.clear();
+    
+    std::atomic<bool> watchFailed(!stats.watching);
+    
+    walkUtils::walk(indexRoot, indexOptions, [&](const std::string &path) {
+        std::lock_guard<std::mutex> lock(walkMutex);
+        files.insert(path);
+    }, [&](const std::string &path) {
+        if (watchFailed)
+        {
+            return;
+        }
+        
+        // Fails once the user's watch limit is reached.
+        int watchFd = inotify_add_watch(inotifyFd, path.c_str(), kWatchMask);
+        
+        if (watchFd < 0)
+        {
+            watchFailed = true;
+            return;
+        }
+        
+        std::lock_guard<std::mutex> lock(walkMutex);
+        watchedDirectories[watchFd] = path;
+    });
+    
+    if (watchFailed && stats.watching)
+    {
+        // A partly watched tree would miss changes: walk it for every snapshot instead.
+        for (auto &watched : watchedDirectories)
+        {
+            inotify_rm_watch(inotifyFd, watched.first);
+        }
+        
+        watchedDirectories.clear();
+        stats.watching = false;
+    }
+    
+    stats.directories = watchedDirectories.size();
+#else
+    walkUtils::walk(indexRoot, indexOptions, [&](const std::string &path) {
+        std::lock_guard<std::mutex> lock(walkMutex);
+        files.insert(path);
+    });
+#endif
+    
+    indexedFiles.swap(files);
+    stale = false;
+    ++stats.rebuilds;
+}
+
+#ifdef __linux__
+/*
+ Update the list of files after an event. indexMutex must be held.
+ */
+static void applyEvent(const struct inotify_event &event)
+{
+    ++stats.events;
+    
+    if (event.mask & IN_Q_OVERFLOW)
+    {
+        stale = true;
+        return;
+    }
+    
+    auto it = watchedDirectories.find(event.wd);
+    
+    // Events of the watches removed by a rebuild are late.
+    if (it == watchedDirectories.end())
+    {
+        return;
+    }
+    
+    if (event.mask & IN_IGNORED)
+    {
+        watchedDirectories.erase(it);
+        return;
+    }
+    
+    // The watched directory itself was moved or deleted.
+    if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+    {
+        stale = true;
+        return;
+    }
+    
+    std::string name = event.len > 0 ? event.name : "";
+    std::string path = it->second + "/" + name;
+    
+    if (event.mask & IN_ISDIR)
+    {
+        if (event.mask & IN_DELETE)
+        {
+            // Its files were deleted first, this only drops leftovers.
+            auto prefix = path + "/";
+            indexedFiles.erase(indexedFiles.lower_bound(prefix), indexedFiles.lower_bound(path + "0"));
+        }
+        else
+        {
+            // New subtrees must be walked with the ignore files of their parents.
+            stale = true;
+        }
+        
+        return;
+    }
+    
+    if (std::find(indexOptions.ignoreFiles.begin(), indexOptions.ignoreFiles.end(), name) != indexOptions.ignoreFiles.end())
+    {
+        stale = true;
+        return;
+    }
+    
+    if (event.mask & (IN_DELETE | IN_MOVED_FROM))
+    {
+        if (indexedFiles.erase(path) > 0)
+        {
+            changedFiles.insert(path);
+            return;
+        }
+    }
+    else if (indexedFiles.count(path) > 0 || walkUtils::isIncluded(indexRoot, path, indexOptions))
+    {
+        indexedFiles.insert(path);
+        changedFiles.insert(path);
+        return;
+    }
+    
+    // Documents may link to any file.
+    changedOtherFiles.insert(path);
+}
+
+static void watchLoop()
+{
+    alignas(struct inotify_event) char buffer[kEventBufferSize];
+    
+    while (true)
+    {
+        struct pollfd descriptors[2] = {{inotifyFd, POLLIN, 0}, {wakePipe[0], POLLIN, 0}};
+        
+        if (poll(descriptors, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            
+            break;
+        }
+        
+        if (descriptors[1].revents != 0)
+        {
+            break;
+        }
+        
+        ssize_t count = read(inotifyFd, buffer, sizeof(buffer));
+        
+        if (count <= 0)
+        {
+            continue;
+        }
+        
+        std::lock_guard<std::mutex> lock(indexMutex);
+        
+        for (ssize_t offset = 0; offset < count;)
+        {
+            auto event = (struct inotify_event *)(buffer + offset);
+            applyEvent(*event);
+            offset += sizeof(struct inotify_event) + event->len;
+        }
+        
+        lastChangeAt = std::chrono::steady_clock::now();
+        changesCondition.notify_all();
+    }
+}
+#endif
+
+void indexUtils::start(const std::string &root, const walkOptions_t &options)
+{
+    std::lock_guard<std::mutex> lock(indexMutex);
+    
+    indexRoot = root;
+    indexOptions = options;
+    
+#ifdef __linux__
+    if (inotifyFd < 0)
+    {
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        
+        if (inotifyFd >= 0 && pipe2(wakePipe, O_CLOEXEC) != 0)
+        {
+            close(inotifyFd);
+            inotifyFd = -1;
+        }
+        
+        stats.watching = inotifyFd >= 0;
+    }
+#endif
+    
+    rebuild();
+    
+#ifdef __linux__
+    if (stats.watching && !watcherThread.joinable())
+    {
+        watcherThread = std::thread(watchLoop);
+    }
+#endif
+}
+
+/*
+ The files of the index, from now on the reference of changedFiles. indexMutex must be held.
+ */
+static std::vector<std::string> takeSnapshot(const walkOptions_t &options)
+{
+    if (!sameOptions(options, indexOptions))
+    {
+        indexOptions = options;
+        stale = true;
+    }
+    
+    if (stale || !stats.watching)
+    {
+        rebuild();
+    }
+    
+    changedFiles.clear();
+    changedOtherFiles.clear();
+    
+    return std::vector<std::string>(indexedFiles.begin(), indexedFiles.end());
+}
+
+std::vector<std::string> indexUtils::snapshot(const walkOptions_t &options)
+{
+    std::lock_guard<std::mutex> lock(indexMutex);
+    return takeSnapshot(options);
+}
+
+bool indexUtils::waitForChanges(double quietSeconds, const walkOptions_t &options, std::set<std::string> &changedPaths, std::set<std::string> &otherPaths, std::vector<std::string> &paths)
+{
+    std::unique_lock<std::mutex> lock(indexMutex);
+    
+    while (stats.watching && !cancelUtils::isCancelled())
+    {
+        bool changed = changedFiles.size() > 0 || changedOtherFiles.size() > 0 || stale;
+        auto quietFor = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastChangeAt).count();
+        
+        if (changed && quietFor >= quietSeconds)
+        {
+            // Under the same lock: changes made in between are left for the next call.
+            changedPaths.swap(changedFiles);
+            changedFiles.clear();
+            otherPaths.swap(changedOtherFiles);
+            changedOtherFiles.clear();
+            paths = takeSnapshot(options);
+            
+            return true;
+        }
+        
+        // Short waits, so that cancelling is noticed.
+        changesCondition.wait_for(lock, std::chrono::milliseconds(50));
+    }
+    
+    return false;
+}
+
+void indexUtils::stop()
+{
+#ifdef __linux__
+    if (watcherThread.joinable())
+    {
+        char wake = 0;
+        
+        if (write(wakePipe[1], &wake, 1) == 1)
+        {
+            watcherThread.join();
+        }
+        else
+        {
+            watcherThread.detach();
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(indexMutex);
+    
+    if (inotifyFd >= 0)
+    {
+        close(inotifyFd);
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+        inotifyFd = -1;
+    }
+    
+    watchedDirectories.clear();
+    stats.watching = false;
+    stale = true;
+#endif
+}
+
+indexStatistics_t indexUtils::statistics()
+{
+    std::lock_guard<std::mutex> lock(indexMutex);
+    
+    auto result = stats;
+    result.files = indexedFiles.size();
+    
+    return result;
+}
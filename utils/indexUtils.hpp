@@ -0,0 +1,108 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef indexUtils_hpp
+#define indexUtils_hpp
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "walkUtils.hpp"
+
+struct indexStatistics_t
+{
+    bool watching; // Whether changes are followed (inotify), rather than the tree walked for each snapshot
+    size_t files;
+    size_t directories; // Watched
+    size_t events; // File system events applied since the start
+    size_t rebuilds; // Full walks, the first one included
+};
+
+namespace indexUtils
+{
+    /*
+     @brief: walk a tree once and keep its file list in memory, following the changes with
+            inotify from a background thread: created, deleted, modified and moved files
+            update the list one by one. Events the list cannot follow alone (new or moved
+            directories, edited ignore files, queue overflows) mark it stale, and the next
+            snapshot walks the tree again. Without inotify, every snapshot walks the tree.
+     
+     @param `root` The directory to index.
+     @param `options` The options to walk it with, see walkOptions_t.
+     
+     @return void.
+     */
+    void start(const std::string &root, const walkOptions_t &options);
+    
+    /*
+     @brief: return the files of the index, walking the tree again only when it is stale or
+            when `options` differ from those it was built with (which then replace them).
+            Must not be called while tasks are running on the shared pool.
+     
+     @param `options` The options the files must match, see walkOptions_t.
+     
+     @return std::vector<std::string>. The paths, sorted, starting with the root.
+     */
+    std::vector<std::string> snapshot(const walkOptions_t &options);
+    
+    /*
+     @brief: wait until files change, then until no change happened for `quietSeconds`, so
+            that a burst of events (an editor saving, a checkout) is reported once. Changes
+            are collected from the last snapshot on, and a new one is taken along with them.
+            Must not be called while tasks are running on the shared pool.
+     
+     @param `quietSeconds` How long the tree must stay unchanged.
+     @param `options` The options the files must match, see snapshot.
+     @param `changedPaths` Filled with the files created, saved, moved or deleted. Changes
+            which made the index stale are not listed: compare `paths` with the previous
+            snapshot.
+     @param `otherPaths` Filled likewise with the files of the watched directories which are
+            not in the index (images, style sheets, the cache files the program writes...).
+     @param `paths` Filled with the new snapshot, see snapshot.
+     
+     @return bool. False if the run was cancelled (see cancelUtils) or changes are not watched.
+     */
+    bool waitForChanges(double quietSeconds, const walkOptions_t &options, std::set<std::string> &changedPaths, std::set<std::string> &otherPaths, std::vector<std::string> &paths);
+    
+    /*
+     @brief: stop following changes and join the watcher thread.
+     
+     @return void.
+     */
+    void stop();
+    
+    /*
+     @brief: return the statistics of the index.
+     
+     @return indexStatistics_t.
+     */
+    indexStatistics_t statistics();
+}
+
+#endif /* indexUtils_hpp */
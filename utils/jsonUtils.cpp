@@ -0,0 +1,422 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#include "jsonUtils.hpp"
+
+// Nesting depth after which skipValue gives up, so that hostile input cannot exhaust the stack.
+#define kMaxSkipDepth 256
+
+static void appendUtf8(std::string &value, uint32_t codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        value += (char)codePoint;
+    }
+    else if (codePoint < 0x800)
+    {
+        value += (char)(0xc0 | (codePoint >> 6));
+        value += (char)(0x80 | (codePoint & 0x3f));
+    }
+    else if (codePoint < 0x10000)
+    {
+        value += (char)(0xe0 | (codePoint >> 12));
+        value += (char)(0x80 | ((codePoint >> 6) & 0x3f));
+        value += (char)(0x80 | (codePoint & 0x3f));
+    }
+    else
+    {
+        value += (char)(0xf0 | (codePoint >> 18));
+        value += (char)(0x80 | ((codePoint >> 12) & 0x3f));
+        value += (char)(0x80 | ((codePoint >> 6) & 0x3f));
+        value += (char)(0x80 | (codePoint & 0x3f));
+    }
+}
+
+jsonUtils::reader::reader(const std::string &text) : text(text), idx(0), error(false), first(false)
+{
+}
+
+bool jsonUtils::reader::fail()
+{
+    error = true;
+    return false;
+}
+
+void jsonUtils::reader::skipWhiteSpace()
+{
+    while (idx < text.length() && (text[idx] == ' ' || text[idx] == '\n' || text[idx] == '\r' || text[idx] == '\t'))
+    {
+        ++idx;
+    }
+}
+
+bool jsonUtils::reader::consume(char expected)
+{
+    skipWhiteSpace();
+    
+    if (error || idx >= text.length() || text[idx] != expected)
+    {
+        return fail();
+    }
+    
+    ++idx;
+    return true;
+}
+
+bool jsonUtils::reader::endOrSeparator(char closing, bool &more)
+{
+    skipWhiteSpace();
+    
+    if (error || idx >= text.length())
+    {
+        return fail();
+    }
+    
+    if (text[idx] == closing)
+    {
+        ++idx;
+        more = false;
+        first = false;
+        return true;
+    }
+    
+    if (!first && !consume(','))
+    {
+        return false;
+    }
+    
+    more = true;
+    first = false;
+    return true;
+}
+
+bool jsonUtils::reader::beginObject()
+{
+    first = true;
+    return consume('{');
+}
+
+bool jsonUtils::reader::nextKey(std::string &key)
+{
+    bool more;
+    
+    if (!endOrSeparator('}', more) || !more)
+    {
+        return false;
+    }
+    
+    return readString(key) && consume(':');
+}
+
+bool jsonUtils::reader::beginArray()
+{
+    first = true;
+    return consume('[');
+}
+
+bool jsonUtils::reader::nextElement()
+{
+    bool more;
+    return endOrSeparator(']', more) && more;
+}
+
+bool jsonUtils::reader::readHexQuad(uint32_t &codePoint)
+{
+    if (idx + 4 > text.length())
+    {
+        return fail();
+    }
+    
+    codePoint = 0;
+    
+    for (size_t end = idx + 4; idx < end; ++idx)
+    {
+        char c = text[idx];
+        codePoint <<= 4;
+        
+        if (c >= '0' && c <= '9')
+        {
+            codePoint |= c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            codePoint |= c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            codePoint |= c - 'A' + 10;
+        }
+        else
+        {
+            return fail();
+        }
+    }
+    
+    return true;
+}
+
+bool jsonUtils::reader::readString(std::string &value)
+{
+    if (!consume('"'))
+    {
+        return false;
+    }
+    
+    value.clear();
+    
+    while (idx < text.length())
+    {
+        // Copy unescaped runs at once.
+        size_t runEnd = idx;
+        
+        while (runEnd < text.length() && text[runEnd] != '"' && text[runEnd] != '\\')
+        {
+            ++runEnd;
+        }
+        
+        value.append(text, idx, runEnd - idx);
+        idx = runEnd;
+        
+        if (idx >= text.length())
+        {
+            break;
+        }
+        
+        if (text[idx++] == '"')
+        {
+            return true;
+        }
+        
+        if (idx >= text.length())
+        {
+            break;
+        }
+        
+        switch (text[idx++])
+        {
+            case '"': value += '"'; break;
+            case '\\': value += '\\'; break;
+            case '/': value += '/'; break;
+            case 'b': value += '\b'; break;
+            case 'f': value += '\f'; break;
+            case 'n': value += '\n'; break;
+            case 'r': value += '\r'; break;
+            case 't': value += '\t'; break;
+            case 'u':
+            {
+                uint32_t codePoint;
+                
+                if (!readHexQuad(codePoint))
+                {
+                    return false;
+                }
+                
+                // Characters outside of the basic plane come as surrogate pairs.
+                if (codePoint >= 0xd800 && codePoint <= 0xdbff)
+                {
+                    uint32_t low;
+                    
+                    if (text.compare(idx, 2, "\\u") != 0)
+                    {
+                        return fail();
+                    }
+                    
+                    idx += 2;
+                    
+                    if (!readHexQuad(low) || low < 0xdc00 || low > 0xdfff)
+                    {
+                        return fail();
+                    }
+                    
+                    codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                }
+                
+                appendUtf8(value, codePoint);
+                break;
+            }
+            default:
+                return fail();
+        }
+    }
+    
+    // Truncated.
+    return fail();
+}
+
+bool jsonUtils::reader::readInteger(int64_t &value)
+{
+    skipWhiteSpace();
+    
+    if (error || idx >= text.length())
+    {
+        return fail();
+    }
+    
+    const char *begin = text.c_str() + idx;
+    char *end;
+    
+    double number = std::strtod(begin, &end);
+    
+    // strtod also accepts hexadecimal, infinities and leading '+', json does not.
+    if (end == begin || !(*begin == '-' || (*begin >= '0' && *begin <= '9')) || std::memchr(begin, 'x', end - begin) || std::memchr(begin, 'X', end - begin))
+    {
+        return fail();
+    }
+    
+    idx += end - begin;
+    value = (int64_t)number;
+    
+    return true;
+}
+
+bool jsonUtils::reader::skipString()
+{
+    if (!consume('"'))
+    {
+        return false;
+    }
+    
+    while (idx < text.length())
+    {
+        char c = text[idx++];
+        
+        if (c == '"')
+        {
+            return true;
+        }
+        
+        if (c == '\\')
+        {
+            ++idx;
+        }
+    }
+    
+    return fail();
+}
+
+bool jsonUtils::reader::skipLiteral(const char *literal)
+{
+    size_t length = std::strlen(literal);
+    
+    if (text.compare(idx, length, literal) != 0)
+    {
+        return fail();
+    }
+    
+    idx += length;
+    return true;
+}
+
+bool jsonUtils::reader::skipValue()
+{
+    skipWhiteSpace();
+    
+    if (error || idx >= text.length())
+    {
+        return fail();
+    }
+    
+    char c = text[idx];
+    
+    if (c == '"')
+    {
+        return skipString();
+    }
+    
+    if (c == 't')
+    {
+        return skipLiteral("true");
+    }
+    
+    if (c == 'f')
+    {
+        return skipLiteral("false");
+    }
+    
+    if (c == 'n')
+    {
+        return skipLiteral("null");
+    }
+    
+    if (c != '{' && c != '[')
+    {
+        int64_t number;
+        return readInteger(number);
+    }
+    
+    // Containers are skipped without recursion: only brackets and strings matter.
+    size_t depth = 0;
+    
+    while (idx < text.length())
+    {
+        c = text[idx];
+        
+        if (c == '"')
+        {
+            if (!skipString())
+            {
+                return false;
+            }
+            
+            continue;
+        }
+        
+        ++idx;
+        
+        if (c == '{' || c == '[')
+        {
+            if (++depth > kMaxSkipDepth)
+            {
+                return fail();
+            }
+        }
+        else if (c == '}' || c == ']')
+        {
+            if (--depth == 0)
+            {
+                return true;
+            }
+        }
+    }
+    
+    return fail();
+}
+
+bool jsonUtils::reader::atEnd()
+{
+    skipWhiteSpace();
+    return !error && idx == text.length();
+}
+
+bool jsonUtils::reader::failed() const
+{
+    return error;
+}
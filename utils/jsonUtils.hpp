@@ -0,0 +1,138 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef jsonUtils_hpp
+#define jsonUtils_hpp
+
+#include <cstdint>
+#include <string>
+
+namespace jsonUtils
+{
+    /*
+     A streaming (pull) json reader: values are decoded one at a time, straight from the text,
+     into the caller's variables. Nothing is allocated but the strings the caller asks for.
+     Every method returns false on malformed input; the reader is unusable afterwards.
+     
+     Typical use on `{"a": [1, 2]}`:
+        reader.beginObject(); while (reader.nextKey(key)) { reader.beginArray(); while (reader.nextElement()) reader.readInteger(value); }
+     */
+    class reader
+    {
+    public:
+        explicit reader(const std::string &text);
+        
+        /*
+         @brief: consume the opening bracket of an object.
+         
+         @return bool.
+         */
+        bool beginObject();
+        
+        /*
+         @brief: move to the next member of the current object and read its key. The value
+                must then be consumed (read or skipped) before calling nextKey again.
+         
+         @param `key` Set to the key of the member.
+         
+         @return bool. False at the end of the object (its closing bracket is consumed) or on error.
+         */
+        bool nextKey(std::string &key);
+        
+        /*
+         @brief: consume the opening bracket of an array.
+         
+         @return bool.
+         */
+        bool beginArray();
+        
+        /*
+         @brief: move to the next element of the current array, which must then be consumed.
+         
+         @return bool. False at the end of the array (its closing bracket is consumed) or on error.
+         */
+        bool nextElement();
+        
+        /*
+         @brief: read a string value, decoding its escape sequences to utf-8.
+         
+         @param `value` Set to the string.
+         
+         @return bool. False if the next value is not a string.
+         */
+        bool readString(std::string &value);
+        
+        /*
+         @brief: read a number value, dropping its fractional part.
+         
+         @param `value` Set to the number.
+         
+         @return bool. False if the next value is not a number.
+         */
+        bool readInteger(int64_t &value);
+        
+        /*
+         @brief: skip the next value, whatever its type.
+         
+         @return bool.
+         */
+        bool skipValue();
+        
+        /*
+         @brief: return whether the whole text was consumed (but white space).
+         
+         @return bool.
+         */
+        bool atEnd();
+        
+        /*
+         @brief: return whether an error was met.
+         
+         @return bool.
+         */
+        bool failed() const;
+        
+    private:
+        bool fail();
+        void skipWhiteSpace();
+        bool consume(char expected);
+        bool endOrSeparator(char closing, bool &more);
+        bool skipString();
+        bool skipLiteral(const char *literal);
+        bool readHexQuad(uint32_t &codePoint);
+        
+        const std::string &text;
+        size_t idx;
+        bool error;
+        
+        // Whether the current object/array still expects its first member.
+        bool first;
+    };
+}
+
+#endif /* jsonUtils_hpp */
@@ -0,0 +1,311 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#include "json.hpp"
+#include "ledgerUtils.hpp"
+
+using json = nlohmann::json;
+
+// Requests older than this are useless for any sensible window.
+#define kLedgerRetentionSeconds (7 * 24 * 3600.0)
+
+static std::mutex ledgerMutex;
+static std::map<std::string, std::vector<double>> requests; // Endpoint -> send times
+static std::map<std::string, std::set<std::string>> deferred; // Endpoint -> paths
+static std::set<std::string> erroring;
+
+struct budget_t
+{
+    size_t requests;
+    double windowSeconds;
+    size_t reserved; // Requests allowed but not sent yet
+};
+
+static std::map<std::string, budget_t> budgets; // Endpoint -> limit of this process
+
+static double now()
+{
+    // Wall clock, since the ledger outlives the process.
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void ledgerUtils::load(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    
+    requests.clear();
+    deferred.clear();
+    erroring.clear();
+    
+    std::ifstream ifs(path);
+    
+    if (!ifs)
+    {
+        return;
+    }
+    
+    try
+    {
+        json ledger = json::parse(ifs);
+        
+        for (auto it = ledger["requests"].begin(); it != ledger["requests"].end(); ++it)
+        {
+            for (auto &time : it.value())
+            {
+                requests[it.key()].push_back(time);
+            }
+        }
+        
+        for (auto it = ledger["deferred"].begin(); it != ledger["deferred"].end(); ++it)
+        {
+            for (auto &deferredPath : it.value())
+            {
+                deferred[it.key()].insert(deferredPath.get<std::string>());
+            }
+        }
+        
+        for (auto &erroringPath : ledger["erroring"])
+        {
+            erroring.insert(erroringPath.get<std::string>());
+        }
+    }
+    catch (const std::exception &)
+    {
+        // Better forget past requests than refuse to run.
+        requests.clear();
+        deferred.clear();
+        erroring.clear();
+    }
+}
+
+bool ledgerUtils::save(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    
+    json ledger;
+    ledger["requests"] = json::object();
+    ledger["deferred"] = json::object();
+    ledger["erroring"] = json::array();
+    
+    double oldest = now() - kLedgerRetentionSeconds;
+    
+    for (auto &entry : requests)
+    {
+        json times = json::array();
+        
+        for (auto time : entry.second)
+        {
+            if (time >= oldest)
+            {
+                times.push_back(time);
+            }
+        }
+        
+        ledger["requests"][entry.first] = times;
+    }
+    
+    for (auto &entry : deferred)
+    {
+        json paths = json::array();
+        
+        for (auto &deferredPath : entry.second)
+        {
+            paths.push_back(deferredPath);
+        }
+        
+        ledger["deferred"][entry.first] = paths;
+    }
+    
+    for (auto &erroringPath : erroring)
+    {
+        ledger["erroring"].push_back(erroringPath);
+    }
+    
+    std::string temporaryPath = path + ".tmp";
+    
+    {
+        std::ofstream ofs(temporaryPath);
+        ofs << ledger.dump();
+        
+        if (!ofs)
+        {
+            return false;
+        }
+    }
+    
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+// Call with ledgerMutex held.
+static size_t countRecentRequests(const std::string &endpoint, double windowSeconds)
+{
+    double oldest = now() - windowSeconds;
+    auto &times = requests[endpoint];
+    
+    return std::count_if(times.begin(), times.end(), [oldest](double time) { return time >= oldest; });
+}
+
+void ledgerUtils::recordRequest(const std::string &endpoint)
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    
+    requests[endpoint].push_back(now());
+    
+    auto it = budgets.find(endpoint);
+    
+    if (it != budgets.end() && it->second.reserved > 0)
+    {
+        --it->second.reserved;
+    }
+}
+
+void ledgerUtils::setBudget(const std::string &endpoint, size_t requests, double windowSeconds, size_t planned)
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    budgets[endpoint] = {requests, windowSeconds, planned};
+}
+
+void ledgerUtils::clearBudgets()
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    budgets.clear();
+}
+
+bool ledgerUtils::reserveRequest(const std::string &endpoint)
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    
+    auto it = budgets.find(endpoint);
+    
+    if (it == budgets.end())
+    {
+        return true;
+    }
+    
+    auto &budget = it->second;
+    
+    if (countRecentRequests(endpoint, budget.windowSeconds) + budget.reserved >= budget.requests)
+    {
+        return false;
+    }
+    
+    ++budget.reserved;
+    return true;
+}
+
+void ledgerUtils::releaseRequest(const std::string &endpoint)
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    
+    auto it = budgets.find(endpoint);
+    
+    if (it != budgets.end() && it->second.reserved > 0)
+    {
+        --it->second.reserved;
+    }
+}
+
+size_t ledgerUtils::countRequests(const std::string &endpoint, double windowSeconds)
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    return countRecentRequests(endpoint, windowSeconds);
+}
+
+std::set<std::string> ledgerUtils::deferredPaths(const std::string &endpoint)
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    
+    // Looked up without adding an entry, which would be saved.
+    auto it = deferred.find(endpoint);
+    
+    return it == deferred.end() ? std::set<std::string>() : it->second;
+}
+
+void ledgerUtils::setDeferredPaths(const std::string &endpoint, const std::set<std::string> &paths)
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    deferred[endpoint] = paths;
+}
+
+bool ledgerUtils::wasErroring(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    return erroring.count(path) > 0;
+}
+
+void ledgerUtils::setErroring(const std::string &path, bool isErroring)
+{
+    std::lock_guard<std::mutex> lock(ledgerMutex);
+    
+    if (isErroring)
+    {
+        erroring.insert(path);
+    }
+    else
+    {
+        erroring.erase(path);
+    }
+}
+
+std::set<uint64_t> ledgerUtils::selectDeferred(std::vector<budgetCandidate_t> candidates, size_t available)
+{
+    std::set<uint64_t> ret;
+    
+    if (candidates.size() <= available)
+    {
+        return ret;
+    }
+    
+    std::sort(candidates.begin(), candidates.end(), [](const budgetCandidate_t &lhs, const budgetCandidate_t &rhs) {
+        if (lhs.previouslyErroring != rhs.previouslyErroring)
+        {
+            return lhs.previouslyErroring;
+        }
+        
+        if (lhs.previouslyDeferred != rhs.previouslyDeferred)
+        {
+            return lhs.previouslyDeferred;
+        }
+        
+        return lhs.modificationTime > rhs.modificationTime;
+    });
+    
+    for (size_t i = available; i < candidates.size(); ++i)
+    {
+        ret.insert(candidates[i].contentHash);
+    }
+    
+    return ret;
+}
@@ -0,0 +1,179 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef ledgerUtils_hpp
+#define ledgerUtils_hpp
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+struct budgetCandidate_t
+{
+    uint64_t contentHash;
+    bool previouslyErroring; // Any of its paths had errors when it was last validated
+    bool previouslyDeferred; // Any of its paths was deferred by a previous run
+    double modificationTime; // Of its most recently modified path
+};
+
+namespace ledgerUtils
+{
+    /*
+     @brief: load the ledger from a file, replacing the in-memory one.
+            A missing or unreadable file results in an empty ledger.
+     
+     @param `path` The path to the ledger file.
+     
+     @return void.
+     */
+    void load(const std::string &path);
+    
+    /*
+     @brief: write the ledger to a file, atomically. Requests older than a week are forgotten.
+     
+     @param `path` The path to the ledger file.
+     
+     @return bool. False if the file could not be written.
+     */
+    bool save(const std::string &path);
+    
+    /*
+     @brief: record that a request was just sent to `endpoint`, using up one of its
+            reservations if any (see reserveRequest). Safe to call concurrently.
+     
+     @param `endpoint` The url of the service.
+     
+     @return void.
+     */
+    void recordRequest(const std::string &endpoint);
+    
+    /*
+     @brief: limit the requests sent to `endpoint` from now on, in addition to the documents
+            deferred by selectDeferred: retries, hedges and re-sends go through reserveRequest.
+            Replaces the reservations of the previous limit.
+     
+     @param `endpoint` The url of the service.
+     @param `requests` The maximum number of requests per window.
+     @param `windowSeconds` The length of the rolling window.
+     @param `planned` The requests already planned within the budget, reserved right away.
+     
+     @return void.
+     */
+    void setBudget(const std::string &endpoint, size_t requests, double windowSeconds, size_t planned);
+    
+    /*
+     @brief: remove the limits set by setBudget, of every endpoint.
+     
+     @return void.
+     */
+    void clearBudgets();
+    
+    /*
+     @brief: set a request to `endpoint` aside, if it fits in its budget along with the
+            requests already recorded and reserved. Endpoints without a budget always have
+            room. The reservation is used up by recordRequest, or given back by releaseRequest.
+     
+     @param `endpoint` The url of the service.
+     
+     @return bool. False if the request would go over budget: it must not be sent.
+     */
+    bool reserveRequest(const std::string &endpoint);
+    
+    /*
+     @brief: give back a reservation whose request was not sent after all.
+     
+     @param `endpoint` The url of the service.
+     
+     @return void.
+     */
+    void releaseRequest(const std::string &endpoint);
+    
+    /*
+     @brief: return the number of requests sent to `endpoint` during the last `windowSeconds`.
+     
+     @param `endpoint` The url of the service.
+     @param `windowSeconds` The length of the rolling window.
+     
+     @return size_t.
+     */
+    size_t countRequests(const std::string &endpoint, double windowSeconds);
+    
+    /*
+     @brief: return the paths whose validation was deferred by previous runs.
+     
+     @param `endpoint` The url of the service.
+     
+     @return std::set<std::string>.
+     */
+    std::set<std::string> deferredPaths(const std::string &endpoint);
+    
+    /*
+     @brief: replace the paths whose validation is deferred to later runs.
+     
+     @param `endpoint` The url of the service.
+     @param `paths` The deferred paths.
+     
+     @return void.
+     */
+    void setDeferredPaths(const std::string &endpoint, const std::set<std::string> &paths);
+    
+    /*
+     @brief: return whether a path had errors when it was last validated.
+     
+     @param `path` The path to an html document.
+     
+     @return bool.
+     */
+    bool wasErroring(const std::string &path);
+    
+    /*
+     @brief: remember whether a path had errors, for the prioritization of later runs.
+     
+     @param `path` The path to an html document.
+     @param `erroring` Whether it has errors.
+     
+     @return void.
+     */
+    void setErroring(const std::string &path, bool erroring);
+    
+    /*
+     @brief: given the documents which need a request and the number of requests left in the
+            budget, return the ones to defer. Previously erroring documents come first, then
+            the ones deferred by previous runs (so that big sites converge), then the most
+            recently modified ones.
+     
+     @param `candidates` The documents which need a request, one per content hash.
+     @param `available` The number of requests left in the budget.
+     
+     @return std::set<uint64_t>. The content hashes to defer.
+     */
+    std::set<uint64_t> selectDeferred(std::vector<budgetCandidate_t> candidates, size_t available);
+}
+
+#endif /* ledgerUtils_hpp */
@@ -0,0 +1,141 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "limiterUtils.hpp"
+#include "threadUtils.hpp"
+
+// A request slower than this many times the average is a sign of queueing on the service.
+#define kLatencySpikeFactor 3.0
+
+// Weight of a new sample in the average latency.
+#define kLatencySmoothing 0.2
+
+typedef std::chrono::steady_clock steadyClock_t;
+
+limiterUtils::aimdLimiter::aimdLimiter(double initialLimit, double minimumLimit, double maximumLimit) :
+limit(initialLimit), minimumLimit(minimumLimit), maximumLimit(maximumLimit), stats(), averageLatency(0)
+{
+    stats.limit = stats.peakLimit = limit;
+}
+
+void limiterUtils::aimdLimiter::schedule(task_t task)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    
+    queuedTasks.push_back(std::move(task));
+    dispatchQueuedTasks(lock);
+}
+
+void limiterUtils::aimdLimiter::dispatchQueuedTasks(std::unique_lock<std::mutex> &lock)
+{
+    std::vector<task_t> dispatched;
+    
+    // At least one request may always run, or a limit below 1 would stall everything.
+    while (queuedTasks.size() > 0 && (stats.inFlight == 0 || stats.inFlight + 1 <= limit))
+    {
+        dispatched.push_back(std::move(queuedTasks.front()));
+        queuedTasks.pop_front();
+        
+        ++stats.inFlight;
+        stats.peakInFlight = std::max(stats.peakInFlight, stats.inFlight);
+    }
+    
+    // Submit outside of the lock: the pool may run the task before submit() returns.
+    lock.unlock();
+    
+    for (auto &task : dispatched)
+    {
+        threadUtils::ioPool().submit(std::move(task));
+    }
+}
+
+void limiterUtils::aimdLimiter::release(double latency, bool overloaded)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    
+    --stats.inFlight;
+    
+    bool spike = averageLatency > 0 && latency > kLatencySpikeFactor * averageLatency;
+    
+    if (overloaded || spike)
+    {
+        // Answers to requests sent before the last backoff reflect the old limit: do not
+        // halve it again for the same congestion episode.
+        auto now = steadyClock_t::now();
+        auto sentAt = now - std::chrono::duration_cast<steadyClock_t::duration>(std::chrono::duration<double>(latency));
+        
+        if (sentAt > lastBackoff)
+        {
+            limit = std::max(minimumLimit, limit / 2);
+            lastBackoff = now;
+            ++stats.backoffs;
+        }
+    }
+    else
+    {
+        limit = std::min(maximumLimit, limit + 1 / limit);
+        averageLatency = averageLatency == 0 ? latency : (1 - kLatencySmoothing) * averageLatency + kLatencySmoothing * latency;
+    }
+    
+    stats.limit = limit;
+    stats.peakLimit = std::max(stats.peakLimit, limit);
+    
+    dispatchQueuedTasks(lock);
+}
+
+void limiterUtils::aimdLimiter::abandon()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    
+    --stats.inFlight;
+    
+    dispatchQueuedTasks(lock);
+}
+
+limiterStatistics_t limiterUtils::aimdLimiter::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void limiterUtils::aimdLimiter::resetStatistics()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    stats.peakLimit = limit;
+    stats.peakInFlight = stats.inFlight;
+    stats.backoffs = 0;
+}
+
+bool limiterUtils::isOverloadStatus(int httpStatus)
+{
+    return httpStatus == 0 || httpStatus == 403 || httpStatus == 429 || httpStatus >= 500;
+}
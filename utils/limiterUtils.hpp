@@ -0,0 +1,122 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef limiterUtils_hpp
+#define limiterUtils_hpp
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+#include "threadUtils.hpp"
+
+struct limiterStatistics_t
+{
+    double limit, peakLimit;
+    size_t inFlight, peakInFlight, backoffs;
+};
+
+namespace limiterUtils
+{
+    /*
+     An adaptive concurrency limit, following the AIMD scheme of TCP congestion control.
+     Every healthy answer raises the limit by 1 / limit (so by about one per round-trip),
+     every sign of overload (throttling or server errors, timeouts, latency spikes) halves it.
+     The limit thus settles around the real capacity of the service.
+     */
+    class aimdLimiter
+    {
+    public:
+        aimdLimiter(double initialLimit, double minimumLimit, double maximumLimit);
+        
+        /*
+         @brief: run a task on the I/O pool as soon as a slot is free. The task must call
+                release() once its request is over. Never blocks the calling thread.
+         
+         @param `task` The task sending the request.
+         
+         @return void.
+         */
+        void schedule(task_t task);
+        
+        /*
+         @brief: give back a slot, and adapt the limit to how the request went.
+         
+         @param `latency` The duration of the request, in seconds.
+         @param `overloaded` Whether the service signalled it is overloaded (e.g. 429, 503).
+         
+         @return void.
+         */
+        void release(double latency, bool overloaded);
+        
+        /*
+         @brief: give back a slot whose request was not sent after all, leaving the limit as is.
+         
+         @return void.
+         */
+        void abandon();
+        
+        /*
+         @brief: return the current limit and its history.
+         
+         @return limiterStatistics_t.
+         */
+        limiterStatistics_t statistics() const;
+        
+        /*
+         @brief: start the history over, e.g. for a new run, keeping the limit learned so far.
+         
+         @return void.
+         */
+        void resetStatistics();
+        
+    private:
+        void dispatchQueuedTasks(std::unique_lock<std::mutex> &lock);
+        
+        mutable std::mutex mutex;
+        double limit, minimumLimit, maximumLimit;
+        limiterStatistics_t stats;
+        std::deque<task_t> queuedTasks;
+        
+        // Smoothed latency of healthy answers: the reference to detect spikes.
+        double averageLatency;
+        std::chrono::steady_clock::time_point lastBackoff;
+    };
+    
+    /*
+     @brief: given an http status code, return whether it means the service is overloaded
+            or refusing our requests (403 and 429 for throttling, 5xx, 0 for no answer).
+     
+     @param `httpStatus` An http status code.
+     
+     @return bool.
+     */
+    bool isOverloadStatus(int httpStatus);
+}
+
+#endif /* limiterUtils_hpp */
@@ -0,0 +1,372 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef pipelineUtils_hpp
+#define pipelineUtils_hpp
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "threadUtils.hpp"
+
+struct stageStatistics_t
+{
+    size_t capacity;
+    size_t processed;
+    size_t peakOccupancy; // Items queued and in progress
+    double averageOccupancy; // Over the life of the stage
+    size_t producerWaits; // Pushes which waited for room
+};
+
+namespace pipelineUtils
+{
+    /*
+     A stage of a pipeline: a bounded MPMC queue, drained by tasks on a pool.
+     Pool workers never wait: a stage stops taking items while one of its outputs is full,
+     and takes them again once the output made room. Only producers outside of the pools
+     wait for room (see pushWaiting), so memory is bounded by the capacities plus the items
+     in progress.
+     */
+    template <typename T>
+    class stage
+    {
+    public:
+        /*
+         Handle an item. Return true once done with it, or false if it is handled
+         asynchronously, in which case finish() must be called once done.
+         */
+        typedef std::function<bool(T &item)> handler_t;
+        
+        /*
+         @param `pool` The pool draining the queue.
+         @param `capacity` The number of queued items over which inputs stop pushing.
+         @param `concurrency` The maximum number of items in progress.
+         @param `handler` See handler_t.
+         */
+        stage(threadUtils::threadPool &pool, size_t capacity, size_t concurrency, handler_t handler) :
+            pool(pool), capacity(capacity), concurrency(concurrency), handler(handler), inProgress(0), draining(0),
+            generation(0), held(false), stats(), occupancyIntegral(0)
+        {
+            stats.capacity = capacity;
+            createdAt = lastChangeAt = std::chrono::steady_clock::now();
+        }
+        
+        ~stage()
+        {
+            waitIdle();
+        }
+        
+        stage(const stage &) = delete;
+        stage &operator=(const stage &) = delete;
+        
+        /*
+         @brief: declare a stage this one pushes items to. Must be called before any push.
+         
+         @param `output` The next stage.
+         
+         @return void.
+         */
+        void addOutput(stage &output)
+        {
+            outputs.push_back(&output);
+            output.inputs.push_back(this);
+        }
+        
+        /*
+         @brief: queue an item, even if the queue is full. Meant for the handlers of the
+                previous stages, which stop taking items until there is room again.
+         
+         @param `item` The item.
+         
+         @return void.
+         */
+        void push(T item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            enqueue(item);
+            startDraining(lock);
+        }
+        
+        /*
+         @brief: queue an item, waiting for room first. Must not be called from a pool worker.
+         
+         @param `item` The item.
+         
+         @return void.
+         */
+        void pushWaiting(T item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            
+            if (!held && queue.size() >= capacity)
+            {
+                ++stats.producerWaits;
+                roomCondition.wait(lock, [this]() {
+                    return held || queue.size() < capacity;
+                });
+            }
+            
+            enqueue(item);
+            startDraining(lock);
+        }
+        
+        /*
+         @brief: mark an item handled asynchronously as done.
+         
+         @return void.
+         */
+        void finish()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            account();
+            --inProgress;
+            ++stats.processed;
+            startDraining(lock);
+        }
+        
+        /*
+         @brief: stop handling items, while still accepting them without limit (e.g. until
+                a decision needs all of them).
+         
+         @return void.
+         */
+        void hold()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            held = true;
+            roomCondition.notify_all();
+        }
+        
+        /*
+         @brief: handle items again, after hold().
+         
+         @return void.
+         */
+        void release()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            held = false;
+            startDraining(lock);
+        }
+        
+        /*
+         @brief: return whether the stage takes more items without going over its capacity.
+         
+         @return bool.
+         */
+        bool hasRoom()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return held || queue.size() < capacity;
+        }
+        
+        /*
+         @brief: wait until no item is queued or in progress, and no task drains the queue.
+                Once every item left the pipeline, wait for all of its stages before
+                destroying any: draining tasks look at the stages around theirs.
+         
+         @return void.
+         */
+        void waitIdle()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            idleCondition.wait(lock, [this]() {
+                return queue.empty() && inProgress == 0 && draining == 0;
+            });
+        }
+        
+        /*
+         @brief: return the statistics of the stage.
+         
+         @return stageStatistics_t.
+         */
+        stageStatistics_t statistics()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            account();
+            
+            auto result = stats;
+            auto lifetime = std::chrono::duration<double>(lastChangeAt - createdAt).count();
+            result.averageOccupancy = lifetime > 0 ? occupancyIntegral / lifetime : 0;
+            
+            return result;
+        }
+        
+    private:
+        /*
+         Add the occupancy since the last change to the integral. mutex must be held.
+         */
+        void account()
+        {
+            auto now = std::chrono::steady_clock::now();
+            
+            occupancyIntegral += (queue.size() + inProgress) * std::chrono::duration<double>(now - lastChangeAt).count();
+            lastChangeAt = now;
+        }
+        
+        /*
+         Queue an item. mutex must be held.
+         */
+        void enqueue(T &item)
+        {
+            account();
+            queue.push_back(std::move(item));
+            stats.peakOccupancy = std::max(stats.peakOccupancy, queue.size() + inProgress);
+        }
+        
+        /*
+         Start a draining task if there is work and room for it. mutex must be held, and is
+         released: the stage may be destroyed as soon as it is idle, so nothing of it is
+         touched afterwards.
+         */
+        void startDraining(std::unique_lock<std::mutex> &lock)
+        {
+            // A draining task about to stop for lack of room checks again.
+            ++generation;
+            
+            if (held || queue.empty() || draining >= concurrency || inProgress >= concurrency)
+            {
+                notifyIfIdle();
+                lock.unlock();
+                return;
+            }
+            
+            ++draining;
+            
+            auto &targetPool = pool;
+            lock.unlock();
+            
+            targetPool.submit([this]() {
+                drain();
+            });
+        }
+        
+        /*
+         mutex must be held.
+         */
+        void notifyIfIdle()
+        {
+            if (queue.empty() && inProgress == 0 && draining == 0)
+            {
+                idleCondition.notify_all();
+            }
+        }
+        
+        /*
+         Wake the inputs which stopped for lack of room.
+         */
+        void wakeInputs()
+        {
+            for (auto input : inputs)
+            {
+                std::unique_lock<std::mutex> lock(input->mutex);
+                input->startDraining(lock);
+            }
+        }
+        
+        bool outputsHaveRoom()
+        {
+            for (auto output : outputs)
+            {
+                if (!output->hasRoom())
+                {
+                    return false;
+                }
+            }
+            
+            return true;
+        }
+        
+        void drain()
+        {
+            while (true)
+            {
+                size_t checkedGeneration;
+                
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    checkedGeneration = generation;
+                }
+                
+                bool room = outputsHaveRoom();
+                
+                std::unique_lock<std::mutex> lock(mutex);
+                
+                if (!room && checkedGeneration != generation)
+                {
+                    // Woken while checking: check again.
+                    continue;
+                }
+                
+                if (held || queue.empty() || inProgress >= concurrency || !room)
+                {
+                    --draining;
+                    notifyIfIdle();
+                    return;
+                }
+                
+                account();
+                T item = std::move(queue.front());
+                queue.pop_front();
+                ++inProgress;
+                roomCondition.notify_all();
+                
+                lock.unlock();
+                
+                wakeInputs();
+                
+                if (handler(item))
+                {
+                    finish();
+                }
+            }
+        }
+        
+        threadUtils::threadPool &pool;
+        size_t capacity, concurrency;
+        handler_t handler;
+        std::vector<stage *> outputs, inputs;
+        
+        std::mutex mutex;
+        std::condition_variable roomCondition, idleCondition;
+        std::deque<T> queue;
+        size_t inProgress, draining, generation;
+        bool held;
+        
+        stageStatistics_t stats;
+        double occupancyIntegral;
+        std::chrono::steady_clock::time_point createdAt, lastChangeAt;
+    };
+}
+
+#endif /* pipelineUtils_hpp */
@@ -26,43 +26,375 @@
  SOFTWARE.
  */
 
-#include <cstdio>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <fcntl.h>
 #include <iostream>
-#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <spawn.h>
 #include <string>
+#include <sys/wait.h>
 #include <thread>
+#include <unistd.h>
 
 #include "shellUtils.hpp"
 
-std::string shellUtils::exec(const std::string &command)
+extern char **environ;
+
+// Outputs are read by chunks of at least this size.
+#define kReadBufferSize 65536
+
+// Attempts to start a program, when the system is out of processes or descriptors.
+#define kSpawnAttempts 6
+
+/*
+ Create a pipe whose both ends are closed on exec: none of them may leak into the programs
+ spawned concurrently by other threads, or readers would not see the end of their input.
+ The child gets its ends through dup2, which clears the flag on the copies.
+ */
+static int makePipe(int fds[2])
 {
-    /*
-     Source: http://stackoverflow.com/questions/478898/how-to-execute-a-command-and-get-output-of-command-within-c-using-posix
-     */
+#ifdef __linux__
+    return pipe2(fds, O_CLOEXEC);
+#else
+    // No pipe2: the window before fcntl cannot be closed.
+    if (pipe(fds) != 0)
+    {
+        return -1;
+    }
     
-    // Bug fix: the program spawns a progressive amount of threads. Make sure not to go over
-    // the limit of open files.
-    const char *cmd = command.c_str();
-    char buffer[128];
-    std::string result = "";
-    std::shared_ptr<FILE> pipe(popen(cmd, "r"), pclose);
-    if (pipe)
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    
+    return 0;
+#endif
+}
+
+shellUtils::childProcess::childProcess(const std::vector<std::string> &arguments, const char *input, size_t length, const processOptions_t &options) : pid(-1), inputFd(-1), outputFd(-1), input(input), length(length), written(0), status(-1), spawnError(0), detached(options.detached), finished(false)
+{
+    // Programs exiting before reading all of their input (e.g. on timeouts) must not kill us.
+    static std::once_flag ignoreBrokenPipes;
+    std::call_once(ignoreBrokenPipes, []() {
+        std::signal(SIGPIPE, SIG_IGN);
+    });
+    
+    int inputPipe[2] = {-1, -1}, outputPipe[2];
+    
+    if (input && makePipe(inputPipe) != 0)
+    {
+        spawnError = errno;
+        finished = true;
+        return;
+    }
+    
+    if (makePipe(outputPipe) != 0)
+    {
+        spawnError = errno;
+        
+        if (input)
+        {
+            close(inputPipe[0]);
+            close(inputPipe[1]);
+        }
+        
+        finished = true;
+        return;
+    }
+    
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    
+    if (input)
+    {
+        posix_spawn_file_actions_adddup2(&actions, inputPipe[0], STDIN_FILENO);
+        posix_spawn_file_actions_addclose(&actions, inputPipe[0]);
+    }
+    
+    posix_spawn_file_actions_adddup2(&actions, outputPipe[1], STDOUT_FILENO);
+    
+    if (options.mergeErrors)
+    {
+        posix_spawn_file_actions_adddup2(&actions, outputPipe[1], STDERR_FILENO);
+    }
+    
+    posix_spawn_file_actions_addclose(&actions, outputPipe[1]);
+    
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    
+    if (detached)
+    {
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attributes, 0);
+    }
+    
+    std::vector<char *> argv;
+    
+    for (auto &argument : arguments)
+    {
+        argv.push_back(const_cast<char *>(argument.c_str()));
+    }
+    
+    argv.push_back(nullptr);
+    
+    spawnError = arguments.size() == 0 ? EINVAL : posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(), environ);
+    
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    close(outputPipe[1]);
+    
+    if (input)
     {
-        while (!feof(pipe.get()))
+        close(inputPipe[0]);
+    }
+    
+    if (spawnError != 0)
+    {
+        if (input)
         {
-            if (fgets(buffer, 128, pipe.get()) != NULL)
-                result += buffer;
+            close(inputPipe[1]);
         }
-        return result;
+        
+        close(outputPipe[0]);
+        pid = -1;
+        finished = true;
+        return;
+    }
+    
+    // Never block on a pipe: write whatever fits, read whatever came.
+    outputFd = outputPipe[0];
+    fcntl(outputFd, F_SETFL, O_NONBLOCK);
+    
+    // Most outputs fit in a single read: avoid growing the string step by step.
+    result.reserve(kReadBufferSize);
+    
+    if (input && length > 0)
+    {
+        inputFd = inputPipe[1];
+        fcntl(inputFd, F_SETFL, O_NONBLOCK);
+    }
+    else if (input)
+    {
+        close(inputPipe[1]);
+    }
+}
+
+shellUtils::childProcess::~childProcess()
+{
+    terminate();
+}
+
+void shellUtils::childProcess::terminate()
+{
+    if (!finished && pid > 0)
+    {
+        kill(detached ? -pid : pid, SIGKILL);
     }
-    else
+    
+    finish();
+}
+
+void shellUtils::childProcess::finish()
+{
+    if (inputFd >= 0)
     {
-        // Wait for a while. In the meantime, another program might end.
-        // Then, retry.
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        //throw std::runtime_error("popen() failed!");
-        return shellUtils::exec(command);
+        close(inputFd);
+        inputFd = -1;
     }
+    
+    if (outputFd >= 0)
+    {
+        close(outputFd);
+        outputFd = -1;
+    }
+    
+    if (pid > 0)
+    {
+        int waitStatus;
+        
+        while (waitpid(pid, &waitStatus, 0) < 0 && errno == EINTR);
+        
+        if (WIFEXITED(waitStatus))
+        {
+            status = WEXITSTATUS(waitStatus);
+        }
+        else if (WIFSIGNALED(waitStatus))
+        {
+            status = 128 + WTERMSIG(waitStatus);
+        }
+        
+        pid = -1;
+    }
+    
+    finished = true;
+}
+
+void shellUtils::childProcess::pump(short inputEvents, short outputEvents)
+{
+    if (inputFd >= 0 && inputEvents != 0)
+    {
+        ssize_t count = write(inputFd, input + written, length - written);
+        
+        if (count > 0)
+        {
+            written += count;
+        }
+        
+        // Also give up if the program stopped reading.
+        if (written == length || (count < 0 && errno != EAGAIN && errno != EINTR))
+        {
+            close(inputFd);
+            inputFd = -1;
+        }
+    }
+    
+    if (outputFd >= 0 && outputEvents != 0)
+    {
+        char buffer[kReadBufferSize];
+        ssize_t count;
+        
+        // Drain the pipe: one poll per chunk written by the program would double the system calls.
+        while ((count = read(outputFd, buffer, sizeof(buffer))) > 0)
+        {
+            result.append(buffer, count);
+        }
+        
+        if (count == 0 || (errno != EINTR && errno != EAGAIN))
+        {
+            // The program is done once its output is closed.
+            finish();
+        }
+    }
+}
+
+bool shellUtils::childProcess::isFinished() const
+{
+    return finished;
+}
+
+int shellUtils::childProcess::startError() const
+{
+    return spawnError;
+}
+
+const std::string &shellUtils::childProcess::output() const
+{
+    return result;
+}
+
+int shellUtils::childProcess::exitStatus() const
+{
+    return status;
+}
+
+int shellUtils::childProcess::waitAny(const std::vector<childProcess *> &processes, double seconds)
+{
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(std::max(seconds, 0.0)));
+    
+    while (true)
+    {
+        std::vector<struct pollfd> fds;
+        
+        for (size_t i = 0; i < processes.size(); ++i)
+        {
+            if (processes[i]->finished)
+            {
+                return (int)i;
+            }
+            
+            fds.push_back({processes[i]->outputFd, POLLIN, 0});
+            fds.push_back({processes[i]->inputFd, POLLOUT, 0});
+        }
+        
+        if (processes.size() == 0)
+        {
+            return -1;
+        }
+        
+        int timeout = -1;
+        
+        if (seconds >= 0)
+        {
+            timeout = (int)std::ceil(std::chrono::duration<double>(end - std::chrono::steady_clock::now()).count() * 1000);
+            
+            if (timeout <= 0)
+            {
+                return -1;
+            }
+        }
+        
+        // Negative descriptors (closed inputs) are ignored by poll.
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+        {
+            // Nothing sensible left to wait for.
+            for (auto process : processes)
+            {
+                process->terminate();
+            }
+            
+            continue;
+        }
+        
+        for (size_t i = 0; i < processes.size(); ++i)
+        {
+            processes[i]->pump(fds[2 * i + 1].revents, fds[2 * i].revents);
+        }
+    }
+}
+
+processResult_t shellUtils::run(const std::vector<std::string> &arguments, const char *input, size_t length, const processOptions_t &options)
+{
+    processResult_t ret;
+    ret.exitStatus = -1;
+    ret.timedOut = false;
+    
+    // Bug fix: the program spawns a progressive amount of threads. Make sure not to go over
+    // the limit of open files: if it is reached, wait for a while, in the meantime another
+    // program might end. Then, retry.
+    for (size_t attempt = 0; attempt < kSpawnAttempts; ++attempt)
+    {
+        if (attempt > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10 << attempt));
+        }
+        
+        childProcess process(arguments, input, length, options);
+        
+        auto error = process.startError();
+        
+        // Missing or forbidden programs will never start.
+        if (error == EAGAIN || error == EMFILE || error == ENFILE || error == ENOMEM)
+        {
+            continue;
+        }
+        else if (error != 0)
+        {
+            break;
+        }
+        
+        if (childProcess::waitAny({&process}, options.timeout > 0 ? options.timeout : -1) < 0)
+        {
+            process.terminate();
+            ret.timedOut = true;
+        }
+        
+        ret.output = process.output();
+        ret.exitStatus = process.exitStatus();
+        break;
+    }
+    
+    return ret;
+}
+
+std::string shellUtils::exec(const std::string &command)
+{
+    // Shares our standard input and error, like popen did: some commands use the terminal.
+    processOptions_t options = {false, false, 0};
+    
+    return shellUtils::run({"/bin/sh", "-c", command}, nullptr, 0, options).output;
 }
 
 void shellUtils::setColor(const shellTextColor &color)
@@ -30,6 +30,8 @@
 #define shellUtils_hpp
 
 #include <string>
+#include <sys/types.h>
+#include <vector>
 
 enum shellTextColor
 {
@@ -56,10 +58,121 @@ enum shellTextColor
     BG_DEFAULT = 49
 };
 
+struct processOptions_t
+{
+    bool mergeErrors; // Capture the standard error along with the standard output
+    bool detached; // In a process group of its own, killed along with its children. Cannot use the terminal.
+    double timeout; // Seconds after which the program is killed, <= 0 for none (see shellUtils::run)
+};
+
+struct processResult_t
+{
+    std::string output;
+    int exitStatus; // See shellUtils::childProcess::exitStatus
+    bool timedOut;
+};
+
 namespace shellUtils
 {
     /*
-     @brief: given a command, run it and return its output.
+     A program running in the background, with its input written and its output read as
+     they become possible. Several of them can be waited for at once (see waitAny), e.g.
+     to race requests. Destroying a running process kills it.
+     */
+    class childProcess
+    {
+    public:
+        /*
+         @brief: start a program, without any shell in between.
+         
+         @param `arguments` The program (looked up in PATH) followed by its arguments.
+         @param `input` The bytes to write to its standard input. Must stay valid as long as
+                the process object exists. nullptr to share our standard input instead.
+         @param `length` The number of bytes of `input`.
+         @param `options` See processOptions_t.
+         */
+        childProcess(const std::vector<std::string> &arguments, const char *input, size_t length, const processOptions_t &options);
+        ~childProcess();
+        
+        childProcess(const childProcess &) = delete;
+        childProcess &operator=(const childProcess &) = delete;
+        
+        /*
+         @brief: return whether the program closed its output and was reaped.
+         
+         @return bool.
+         */
+        bool isFinished() const;
+        
+        /*
+         @brief: return what the program wrote on its standard output so far.
+         
+         @return const std::string &.
+         */
+        const std::string &output() const;
+        
+        /*
+         @brief: return the exit status of a finished program: its exit code, 128 + the signal
+                which killed it, or -1 if it could not be started.
+         
+         @return int.
+         */
+        int exitStatus() const;
+        
+        /*
+         @brief: return why the program could not be started.
+         
+         @return int. The errno of the failure, 0 if it started.
+         */
+        int startError() const;
+        
+        /*
+         @brief: kill the program (and its children if detached), then reap it.
+         
+         @return void.
+         */
+        void terminate();
+        
+        /*
+         @brief: run the processes' I/O until one of them finishes, or `seconds` elapsed.
+         
+         @param `processes` The processes to wait for.
+         @param `seconds` The maximum duration of the wait. Negative to wait forever.
+         
+         @return int. The index of a finished process, -1 on timeout.
+         */
+        static int waitAny(const std::vector<childProcess *> &processes, double seconds);
+        
+    private:
+        void pump(short inputEvents, short outputEvents);
+        void finish();
+        
+        pid_t pid;
+        int inputFd, outputFd;
+        const char *input;
+        size_t length, written;
+        std::string result;
+        int status;
+        int spawnError;
+        bool detached, finished;
+    };
+    
+    /*
+     @brief: run a program to completion, without any shell in between.
+            Failures to start it for lack of resources (processes, descriptors, memory) are
+            retried a few times, others are not.
+     
+     @param `arguments` The program (looked up in PATH) followed by its arguments.
+     @param `input` The bytes to write to its standard input, nullptr to share ours.
+     @param `length` The number of bytes of `input`.
+     @param `options` See processOptions_t.
+     
+     @return processResult_t.
+     */
+    processResult_t run(const std::vector<std::string> &arguments, const char *input, size_t length, const processOptions_t &options);
+    
+    /*
+     @brief: given a command, run it with /bin/sh and return its output.
      
      @param `command` An executable command.
      
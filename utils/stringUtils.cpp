@@ -26,6 +26,8 @@
  SOFTWARE.
  */
 
+#include <cstring>
+
 #include "stringUtils.hpp"
 
 std::vector<std::string> stringUtils::tokenize(const std::string &str, char separator)
@@ -53,25 +55,47 @@ std::vector<std::string> stringUtils::tokenize(const std::string &str, char sepa
 
 void stringUtils::trim(std::string &str)
 {
-    while (str.length() > 0 && str.front() == ' ') {
-        str.erase(str.begin());
+    // Erasing spaces one by one moved the rest of the string every time: quadratic on
+    // indented documents.
+    str = trimmed(str.data(), str.length());
+}
+
+std::string stringUtils::trimmed(const char *data, size_t length)
+{
+    const char *end = data + length;
+    
+    while (data < end && *data == ' ')
+    {
+        ++data;
     }
     
-    for (auto it = str.begin(); it < str.end(); ++it)
+    while (end > data && *(end - 1) == ' ')
     {
-        if (*it == ' ' && it < str.end() - 1 && *(it + 1) == ' ')
-        {
-            str.erase(it);
-            
-            // Bug fix: to make sure the case where the next ' ' is not skipped.
-            --it;
-        }
+        --end;
     }
     
-    while (str.length() > 0 && str.back() == ' ')
+    std::string ret;
+    ret.reserve(end - data);
+    
+    // Copy up to each run of spaces, keeping one, then skip the rest of the run.
+    while (data < end)
     {
-        str.pop_back();
+        auto spaces = (const char *)memmem(data, end - data, "  ", 2);
+        
+        if (!spaces)
+        {
+            ret.append(data, end - data);
+            break;
+        }
+        
+        ret.append(data, spaces + 1 - data);
+        
+        for (data = spaces + 2; data < end && *data == ' '; ++data)
+        {
+        }
     }
+    
+    return ret;
 }
 
 ssize_t stringUtils::firstLineOccurrence(const std::string &str, const std::string &pattern)
@@ -55,6 +55,17 @@ namespace stringUtils
      */
     void trim(std::string &str);
     
+    /*
+     @brief Same as trim, for bytes held elsewhere (a fileUtils::fileBuffer, for instance): they are
+            copied once, already trimmed, into a string of the exact size.
+     
+     @param `data` The bytes to trim.
+     @param `length` The number of bytes.
+     
+     @return std::string.
+     */
+    std::string trimmed(const char *data, size_t length);
+    
     /*
      @brief Return the line in a string where a pattern first occurs.
      
@@ -0,0 +1,299 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "threadUtils.hpp"
+
+#define kDefaultIoJobs 16
+
+static thread_local threadUtils::threadPool *currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+static std::mutex poolsMutex;
+static std::unique_ptr<threadUtils::threadPool> sharedPoolInstance;
+static std::unique_ptr<threadUtils::threadPool> ioPoolInstance;
+static size_t sharedPoolSize = 0, ioPoolSize = 0; // As requested: pools have at least one thread
+
+threadUtils::threadPool::threadPool(size_t threadsCount) :
+stopping(false), nextWorker(0), queued(0), peakQueued(0), executed(0), stolen(0)
+{
+    if (threadsCount == 0)
+    {
+        threadsCount = 1;
+    }
+    
+    for (size_t i = 0; i < threadsCount; ++i)
+    {
+        workers.push_back(std::unique_ptr<worker_t>(new worker_t()));
+    }
+    
+    for (size_t i = 0; i < threadsCount; ++i)
+    {
+        threads.push_back(std::thread(&threadPool::workerLoop, this, i));
+    }
+}
+
+threadUtils::threadPool::~threadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    
+    sleepCondition.notify_all();
+    
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void threadUtils::threadPool::submit(task_t task)
+{
+    // Count the task before it becomes visible, so that `queued` never underflows.
+    size_t depth = ++queued;
+    
+    size_t peak = peakQueued;
+    while (depth > peak && !peakQueued.compare_exchange_weak(peak, depth));
+    
+    // Workers keep the tasks they spawn for themselves: the thieves will balance the load.
+    size_t workerIdx = currentPool == this ? currentWorker : nextWorker++ % workers.size();
+    
+    {
+        std::lock_guard<std::mutex> lock(workers[workerIdx]->mutex);
+        workers[workerIdx]->tasks.push_back(std::move(task));
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    
+    sleepCondition.notify_one();
+}
+
+bool threadUtils::threadPool::isWorkerThread() const
+{
+    return currentPool == this;
+}
+
+poolStatistics_t threadUtils::threadPool::statistics() const
+{
+    poolStatistics_t statistics;
+    
+    statistics.threads = threads.size();
+    statistics.queued = queued;
+    statistics.peakQueued = peakQueued;
+    statistics.executed = executed;
+    statistics.stolen = stolen;
+    
+    return statistics;
+}
+
+void threadUtils::threadPool::resetStatistics()
+{
+    peakQueued = queued.load();
+    executed = 0;
+    stolen = 0;
+}
+
+bool threadUtils::threadPool::popTask(size_t workerIdx, task_t &task)
+{
+    // Own tasks first, newest first: they are the most likely to be hot in the cache.
+    {
+        auto &worker = *workers[workerIdx];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        
+        if (worker.tasks.size() > 0)
+        {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            --queued;
+            return true;
+        }
+    }
+    
+    // Then steal the oldest task of another worker.
+    for (size_t i = 1; i < workers.size(); ++i)
+    {
+        auto &victim = *workers[(workerIdx + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        
+        if (victim.tasks.size() > 0)
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --queued;
+            ++stolen;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void threadUtils::threadPool::workerLoop(size_t workerIdx)
+{
+    currentPool = this;
+    currentWorker = workerIdx;
+    
+    while (true)
+    {
+        task_t task;
+        
+        if (popTask(workerIdx, task))
+        {
+            task();
+            ++executed;
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        
+        if (stopping && queued == 0)
+        {
+            return;
+        }
+        
+        sleepCondition.wait(lock, [this]() { return stopping || queued > 0; });
+    }
+}
+
+threadUtils::taskGroup::taskGroup(threadPool &pool) : pool(pool), pending(0)
+{
+}
+
+threadUtils::taskGroup::~taskGroup()
+{
+    wait();
+}
+
+void threadUtils::taskGroup::run(task_t task)
+{
+    add();
+    
+    pool.submit([this, task]() {
+        task();
+        done();
+    });
+}
+
+void threadUtils::taskGroup::add()
+{
+    ++pending;
+}
+
+void threadUtils::taskGroup::done()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    if (--pending == 0)
+    {
+        condition.notify_all();
+    }
+}
+
+void threadUtils::taskGroup::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    
+    // Holding the mutex on return also makes sure the last task released it, so that the
+    // group can be destroyed right away.
+    condition.wait(lock, [this]() { return pending == 0; });
+}
+
+void threadUtils::configure(size_t jobs, size_t ioJobs)
+{
+    if (jobs == 0)
+    {
+        jobs = std::thread::hardware_concurrency();
+    }
+    
+    std::lock_guard<std::mutex> lock(poolsMutex);
+    
+    if (sharedPoolInstance && ioPoolInstance && sharedPoolSize == jobs && ioPoolSize == ioJobs)
+    {
+        sharedPoolInstance->resetStatistics();
+        ioPoolInstance->resetStatistics();
+        return;
+    }
+    
+    // Destroy the old pools first, so that their threads are joined before new ones spawn.
+    sharedPoolInstance.reset();
+    ioPoolInstance.reset();
+    
+    sharedPoolInstance.reset(new threadPool(jobs));
+    ioPoolInstance.reset(new threadPool(ioJobs));
+    sharedPoolSize = jobs;
+    ioPoolSize = ioJobs;
+}
+
+threadUtils::threadPool &threadUtils::sharedPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(poolsMutex);
+        
+        if (sharedPoolInstance)
+        {
+            return *sharedPoolInstance;
+        }
+    }
+    
+    threadUtils::configure(0, kDefaultIoJobs);
+    
+    return threadUtils::sharedPool();
+}
+
+threadUtils::threadPool &threadUtils::ioPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(poolsMutex);
+        
+        if (ioPoolInstance)
+        {
+            return *ioPoolInstance;
+        }
+    }
+    
+    threadUtils::configure(0, kDefaultIoJobs);
+    
+    return threadUtils::ioPool();
+}
+
+void threadUtils::runBlocking(const task_t &operation)
+{
+    auto &pool = threadUtils::ioPool();
+    
+    if (pool.isWorkerThread())
+    {
+        operation();
+        return;
+    }
+    
+    taskGroup group(pool);
+    group.run(operation);
+    group.wait();
+}
@@ -0,0 +1,203 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef threadUtils_hpp
+#define threadUtils_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> task_t;
+
+struct poolStatistics_t
+{
+    size_t threads, queued, peakQueued, executed, stolen;
+};
+
+namespace threadUtils
+{
+    /*
+     A fixed-size work-stealing thread pool.
+     Every worker owns a queue: it pops its own tasks from the back and, once it runs out,
+     steals from the front of the other workers' queues. Tasks submitted from outside the
+     pool are spread round-robin over the workers.
+     */
+    class threadPool
+    {
+    public:
+        explicit threadPool(size_t threadsCount);
+        ~threadPool();
+        
+        threadPool(const threadPool &) = delete;
+        threadPool &operator=(const threadPool &) = delete;
+        
+        /*
+         @brief: queue a task. It will be run by one of the workers.
+         
+         @param `task` The task to run.
+         
+         @return void.
+         */
+        void submit(task_t task);
+        
+        /*
+         @brief: return whether the calling thread is one of this pool's workers.
+         
+         @return bool.
+         */
+        bool isWorkerThread() const;
+        
+        /*
+         @brief: return the queue depth and throughput counters of the pool.
+         
+         @return poolStatistics_t.
+         */
+        poolStatistics_t statistics() const;
+        
+        /*
+         @brief: start the counters over, e.g. for a new run. The peak depth starts from the
+                current one.
+         
+         @return void.
+         */
+        void resetStatistics();
+        
+    private:
+        struct worker_t
+        {
+            std::mutex mutex;
+            std::deque<task_t> tasks;
+        };
+        
+        bool popTask(size_t workerIdx, task_t &task);
+        void workerLoop(size_t workerIdx);
+        
+        std::vector<std::unique_ptr<worker_t>> workers;
+        std::vector<std::thread> threads;
+        
+        std::mutex sleepMutex;
+        std::condition_variable sleepCondition;
+        bool stopping;
+        
+        std::atomic<size_t> nextWorker, queued, peakQueued, executed, stolen;
+    };
+    
+    /*
+     A set of tasks that can be waited for as a whole.
+     Waiting blocks the calling thread: tasks should not wait for other tasks, but rather
+     hand their continuation over (see add and done).
+     */
+    class taskGroup
+    {
+    public:
+        explicit taskGroup(threadPool &pool);
+        ~taskGroup();
+        
+        /*
+         @brief: submit a task to the group's pool.
+         
+         @param `task` The task to run.
+         
+         @return void.
+         */
+        void run(task_t task);
+        
+        /*
+         @brief: count a piece of work which completes outside of the group's tasks (e.g. in
+                a callback), so that wait() does not return before it. Pair with done().
+         
+         @return void.
+         */
+        void add();
+        
+        /*
+         @brief: mark a piece of work counted with add() as completed.
+         
+         @return void.
+         */
+        void done();
+        
+        /*
+         @brief: return once all the tasks submitted so far have completed.
+         
+         @return void.
+         */
+        void wait();
+        
+    private:
+        threadPool &pool;
+        std::atomic<size_t> pending;
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+    
+    /*
+     @brief: (re)create the shared pools. Must not be called while tasks are running.
+            Pools already of the requested sizes are kept, their statistics started over:
+            threads are only spawned again when the sizes change.
+     
+     @param `jobs` Number of workers of the shared pool. 0 to use one per core.
+     @param `ioJobs` Maximum number of concurrent network operations.
+     
+     @return void.
+     */
+    void configure(size_t jobs, size_t ioJobs);
+    
+    /*
+     @brief: return the pool which documents are validated on. Sized to the cores by default.
+     
+     @return threadPool&.
+     */
+    threadPool &sharedPool();
+    
+    /*
+     @brief: return the pool which blocking network operations run on. Its size is the
+            I/O concurrency limit, independent from the number of cores.
+     
+     @return threadPool&.
+     */
+    threadPool &ioPool();
+    
+    /*
+     @brief: run a blocking operation on the I/O pool and wait for it. From a worker of the
+            I/O pool, the operation simply runs on the calling thread.
+     
+     @param `operation` The blocking operation.
+     
+     @return void.
+     */
+    void runBlocking(const task_t &operation);
+}
+
+#endif /* threadUtils_hpp */
@@ -0,0 +1,464 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "uringUtils.hpp"
+
+// Bigger files are read one at a time by fileUtils::fileBuffer: batches of them would hold a lot of memory.
+#define kReadAheadMaxSize (64 * 1024)
+
+#ifdef __linux__
+// Operations per submission.
+#define kRingEntries 256
+
+/*
+ The rings shared with the kernel, and the submission queue entries.
+ */
+struct ring_t
+{
+    int fd;
+    unsigned entries;
+    
+    unsigned *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    io_uring_sqe *sqes;
+    io_uring_cqe *cqes;
+    
+    void *sqMapping, *cqMapping;
+    size_t sqMappingSize, cqMappingSize;
+};
+
+typedef std::function<void(size_t idx, io_uring_sqe &sqe)> prepareOperation_t;
+
+static ring_t ring;
+static bool ringSetUp = false;
+#endif
+
+static std::mutex uringMutex;
+static bool enabled = false;
+static uringStatistics_t stats = {};
+
+#ifdef __linux__
+/*
+ Set the ring up, or return false if the kernel does not support io_uring (or forbids it).
+ */
+static bool setUpRing()
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    
+    int fd = (int)syscall(__NR_io_uring_setup, kRingEntries, &params);
+    
+    if (fd < 0)
+    {
+        return false;
+    }
+    
+    ring.fd = fd;
+    ring.entries = params.sq_entries;
+    ring.sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    
+    // Both rings can share a mapping since Linux 5.4.
+    bool singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+    
+    if (singleMapping)
+    {
+        ring.sqMappingSize = ring.cqMappingSize = std::max(ring.sqMappingSize, ring.cqMappingSize);
+    }
+    
+    ring.sqMapping = mmap(nullptr, ring.sqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring.cqMapping = singleMapping ? ring.sqMapping : mmap(nullptr, ring.cqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    
+    size_t sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqesMapping = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    
+    if (ring.sqMapping == MAP_FAILED || ring.cqMapping == MAP_FAILED || sqesMapping == MAP_FAILED)
+    {
+        // Mappings go away with the descriptor's last reference.
+        close(fd);
+        return false;
+    }
+    
+    auto sq = (char *)ring.sqMapping;
+    auto cq = (char *)ring.cqMapping;
+    
+    ring.sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ring.sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring.sqArray = (unsigned *)(sq + params.sq_off.array);
+    ring.cqHead = (unsigned *)(cq + params.cq_off.head);
+    ring.cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ring.cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring.sqes = (io_uring_sqe *)sqesMapping;
+    ring.cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+    
+    return true;
+}
+
+/*
+ Whether the ring can be used. uringMutex must be held.
+ */
+static bool ringAvailable()
+{
+    if (!ringSetUp)
+    {
+        ringSetUp = true;
+        stats.available = setUpRing();
+    }
+    
+    return enabled && stats.available;
+}
+
+/*
+ Wait until every submitted operation completed, after io_uring_enter failed: the kernel may
+ still write into their buffers. Returns false if they could not all be waited for.
+ uringMutex must be held.
+ */
+static bool drainOperations(size_t inFlight)
+{
+    while (inFlight > 0)
+    {
+        int ret = (int)syscall(__NR_io_uring_enter, ring.fd, 0, (unsigned)inFlight, IORING_ENTER_GETEVENTS, nullptr, 0);
+        
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            return false;
+        }
+        
+        unsigned head = *ring.cqHead;
+        unsigned cqTail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        
+        inFlight -= std::min<size_t>(inFlight, cqTail - head);
+        __atomic_store_n(ring.cqHead, cqTail, __ATOMIC_RELEASE);
+    }
+    
+    return true;
+}
+
+/*
+ Submit `count` operations (at most ring.entries) at once and wait for all of them. Results
+ are those of the equivalent system calls, with -errno on errors. On failure, the ring is
+ given up and every later call takes the synchronous path. uringMutex must be held.
+ */
+static bool runOperations(size_t count, const prepareOperation_t &prepare, std::vector<int> &results)
+{
+    results.assign(count, -ECANCELED);
+    
+    if (!stats.available)
+    {
+        return false;
+    }
+    
+    unsigned tail = *ring.sqTail;
+    
+    for (size_t i = 0; i < count; ++i)
+    {
+        unsigned idx = (tail + i) & *ring.sqMask;
+        auto &sqe = ring.sqes[idx];
+        
+        memset(&sqe, 0, sizeof(sqe));
+        prepare(i, sqe);
+        sqe.user_data = i;
+        
+        ring.sqArray[idx] = idx;
+    }
+    
+    // The kernel must see the entries before the new tail.
+    __atomic_store_n(ring.sqTail, tail + (unsigned)count, __ATOMIC_RELEASE);
+    
+    size_t submitted = 0;
+    size_t completed = 0;
+    
+    while (completed < count)
+    {
+        int ret = (int)syscall(__NR_io_uring_enter, ring.fd, (unsigned)(count - submitted), (unsigned)(count - completed), IORING_ENTER_GETEVENTS, nullptr, 0);
+        
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            // Without SQPOLL the kernel only takes entries during io_uring_enter: the ones it
+            // did not take are withdrawn, the others must complete before their buffers go.
+            __atomic_store_n(ring.sqTail, tail + (unsigned)submitted, __ATOMIC_RELEASE);
+            
+            if (drainOperations(submitted - completed))
+            {
+                close(ring.fd);
+            }
+            
+            stats.available = false;
+            ++stats.fallbacks;
+            
+            return false;
+        }
+        
+        ++stats.submissions;
+        submitted += std::max(ret, 0);
+        
+        unsigned head = *ring.cqHead;
+        unsigned cqTail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        
+        for (; head != cqTail; ++head)
+        {
+            auto &cqe = ring.cqes[head & *ring.cqMask];
+            
+            if (cqe.user_data < count)
+            {
+                results[cqe.user_data] = cqe.res;
+                ++completed;
+            }
+        }
+        
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+    
+    stats.operations += count;
+    
+    return true;
+}
+#endif
+
+void uringUtils::setEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(uringMutex);
+    ::enabled = enabled;
+}
+
+bool uringUtils::isAvailable()
+{
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(uringMutex);
+    return ringAvailable();
+#else
+    return false;
+#endif
+}
+
+std::vector<std::string> uringUtils::getFileSignatures(const std::vector<std::string> &paths)
+{
+    std::vector<std::string> signatures(paths.size());
+    size_t done = 0;
+    
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(uringMutex);
+    
+    if (ringAvailable())
+    {
+        std::vector<struct statx> buffers(ring.entries);
+        std::vector<int> results;
+        
+        while (done < paths.size())
+        {
+            size_t count = std::min<size_t>(ring.entries, paths.size() - done);
+            
+            bool ran = runOperations(count, [&](size_t idx, io_uring_sqe &sqe) {
+                sqe.opcode = IORING_OP_STATX;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = (uint64_t)(uintptr_t)paths[done + idx].c_str();
+                sqe.len = STATX_SIZE | STATX_MTIME;
+                sqe.off = (uint64_t)(uintptr_t)&buffers[idx];
+            }, results);
+            
+            if (!ran)
+            {
+                break;
+            }
+            
+            for (size_t i = 0; i < count; ++i)
+            {
+                auto &buffer = buffers[i];
+                
+                if (results[i] == 0)
+                {
+                    signatures[done + i] = fileUtils::formatFileSignature(buffer.stx_size, buffer.stx_mtime.tv_sec, buffer.stx_mtime.tv_nsec);
+                }
+                else if (results[i] != -ENOENT && results[i] != -ENOTDIR)
+                {
+                    // Statx itself may be unsupported.
+                    signatures[done + i] = fileUtils::getFileSignature(paths[done + i]);
+                    ++stats.fallbacks;
+                }
+            }
+            
+            done += count;
+        }
+    }
+#endif
+    
+    for (; done < paths.size(); ++done)
+    {
+        signatures[done] = fileUtils::getFileSignature(paths[done]);
+    }
+    
+    return signatures;
+}
+
+std::vector<std::unique_ptr<fileUtils::fileBuffer>> uringUtils::readFiles(const std::vector<std::string> &paths)
+{
+    std::vector<std::unique_ptr<fileUtils::fileBuffer>> files(paths.size());
+    
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(uringMutex);
+    
+    if (!ringAvailable())
+    {
+        return files;
+    }
+    
+    // Files are looked up and opened together, then read, then closed: three submissions
+    // for as many files as half the ring holds.
+    size_t batchSize = ring.entries / 2;
+    
+    std::vector<struct statx> buffers(batchSize);
+    std::vector<std::string> contents(batchSize);
+    std::vector<int> descriptors(batchSize);
+    std::vector<size_t> reads; // Indices in the batch
+    std::vector<int> results;
+    
+    for (size_t done = 0; done < paths.size(); done += batchSize)
+    {
+        size_t count = std::min(batchSize, paths.size() - done);
+        
+        bool ran = runOperations(2 * count, [&](size_t idx, io_uring_sqe &sqe) {
+            auto &path = paths[done + idx / 2];
+            
+            sqe.fd = AT_FDCWD;
+            sqe.addr = (uint64_t)(uintptr_t)path.c_str();
+            
+            if (idx % 2 == 0)
+            {
+                sqe.opcode = IORING_OP_STATX;
+                sqe.len = STATX_SIZE;
+                sqe.off = (uint64_t)(uintptr_t)&buffers[idx / 2];
+            }
+            else
+            {
+                sqe.opcode = IORING_OP_OPENAT;
+                sqe.open_flags = O_RDONLY | O_CLOEXEC;
+            }
+        }, results);
+        
+        if (!ran)
+        {
+            break;
+        }
+        
+        reads.clear();
+        
+        for (size_t i = 0; i < count; ++i)
+        {
+            descriptors[i] = results[2 * i + 1];
+            
+            if (results[2 * i] != 0 || descriptors[i] < 0 || buffers[i].stx_size >= kReadAheadMaxSize)
+            {
+                continue;
+            }
+            
+            // One byte more than looked up: a file which grew in the meantime fills it.
+            contents[i].resize(buffers[i].stx_size + 1);
+            reads.push_back(i);
+        }
+        
+        ran = runOperations(reads.size(), [&](size_t idx, io_uring_sqe &sqe) {
+            auto &buffer = contents[reads[idx]];
+            
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = descriptors[reads[idx]];
+            sqe.addr = (uint64_t)(uintptr_t)&buffer[0];
+            sqe.len = (unsigned)buffer.size();
+            sqe.off = 0;
+        }, results);
+        
+        // Files whose size changed in the meantime are read again by the caller.
+        for (size_t i = 0; ran && i < reads.size(); ++i)
+        {
+            auto &buffer = contents[reads[i]];
+            
+            if (results[i] >= 0 && (size_t)results[i] == buffer.size() - 1)
+            {
+                buffer.pop_back();
+                files[done + reads[i]].reset(new fileUtils::fileBuffer(std::move(buffer)));
+            }
+        }
+        
+        reads.clear();
+        
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (descriptors[i] >= 0)
+            {
+                reads.push_back(i);
+            }
+        }
+        
+        bool closed = runOperations(reads.size(), [&](size_t idx, io_uring_sqe &sqe) {
+            sqe.opcode = IORING_OP_CLOSE;
+            sqe.fd = descriptors[reads[idx]];
+        }, results);
+        
+        // Descriptors must not leak, even if the kernel cannot close them through the ring.
+        for (size_t i = 0; i < reads.size(); ++i)
+        {
+            if (!closed || results[i] < 0)
+            {
+                close(descriptors[reads[i]]);
+            }
+        }
+        
+        if (!ran || !closed)
+        {
+            break;
+        }
+    }
+#endif
+    
+    return files;
+}
+
+uringStatistics_t uringUtils::statistics()
+{
+    std::lock_guard<std::mutex> lock(uringMutex);
+    
+    auto statistics = stats;
+    statistics.enabled = enabled;
+    
+    return statistics;
+}
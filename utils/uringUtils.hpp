@@ -0,0 +1,93 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef uringUtils_hpp
+#define uringUtils_hpp
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fileUtils.hpp"
+
+struct uringStatistics_t
+{
+    bool available; // The kernel set up a ring
+    bool enabled; // See setEnabled
+    size_t submissions, operations, fallbacks;
+};
+
+namespace uringUtils
+{
+    /*
+     Batched file system calls through io_uring (Linux 5.6 and later): many files are looked
+     up, opened, read and closed with a few system calls instead of three or four each. The
+     ring is set up with raw system calls, without liburing. Where io_uring is unavailable,
+     disabled or fails, the same work is done synchronously, one file at a time.
+     */
+    
+    /*
+     @brief: enable or disable io_uring (disabled by default). When disabled, every call takes
+            the synchronous path.
+     
+     @param `enabled` Whether to use io_uring, if available.
+     
+     @return void.
+     */
+    void setEnabled(bool enabled);
+    
+    /*
+     @brief: return whether io_uring is enabled and available, setting it up on first use.
+     
+     @return bool.
+     */
+    bool isAvailable();
+    
+    /*
+     @brief: given paths, return their signatures, as fileUtils::getFileSignature.
+     
+     @param `paths` Paths to files.
+     
+     @return std::vector<std::string>. In the order of `paths`, empty for files which do not exist.
+     */
+    std::vector<std::string> getFileSignatures(const std::vector<std::string> &paths);
+    
+    /*
+     @brief: read small files ahead, in batches. Bigger ones are left to fileUtils::fileBuffer, and nothing is read on the synchronous path: the caller reads what was not read here.
+     
+     @param `paths` Paths to files.
+     
+     @return std::vector<std::unique_ptr<fileUtils::fileBuffer>>. In the order of `paths`, null for
+            files which were not read.
+     */
+    std::vector<std::unique_ptr<fileUtils::fileBuffer>> readFiles(const std::vector<std::string> &paths);
+    
+    uringStatistics_t statistics();
+}
+
+#endif /* uringUtils_hpp */
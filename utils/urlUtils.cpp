@@ -32,9 +32,167 @@
 #include "stringUtils.hpp"
 #include "urlUtils.hpp"
 
-#include <fstream>
+#include <atomic>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Independent locks of the existence cache: link checks run on many threads at once.
+#define kExistenceShards 16
+
+struct existenceShard_t
+{
+    std::mutex mutex;
+    std::unordered_map<std::string, bool> exists; // Keyed by normalized path
+    std::unordered_map<std::string, std::shared_ptr<const std::set<std::string>>> ids; // Likewise
+};
+
+static existenceShard_t existenceShards[kExistenceShards];
+static std::atomic<size_t> existenceLookups(0);
+static std::atomic<size_t> existenceSystemCalls(0);
+
+/*
+ Resolve "." and ".." in a path, and drop repeated "/", without touching the file system.
+ */
+static std::string normalizePath(const std::string &path)
+{
+    bool absolute = path.length() > 0 && path.front() == '/';
+    std::vector<std::string> components;
+    
+    for (auto &component : stringUtils::tokenize(path, '/'))
+    {
+        if (component.length() == 0 || component.compare(".") == 0)
+        {
+            continue;
+        }
+        
+        if (component.compare("..") == 0)
+        {
+            // "/.." is "/", and relative paths may go above their start.
+            if (components.size() > 0 && components.back().compare("..") != 0)
+            {
+                components.pop_back();
+                continue;
+            }
+            else if (absolute)
+            {
+                continue;
+            }
+        }
+        
+        components.push_back(component);
+    }
+    
+    std::string normalized = absolute ? "/" : "";
+    
+    for (size_t i = 0; i < components.size(); ++i)
+    {
+        normalized += (i > 0 ? "/" : "") + components[i];
+    }
+    
+    return normalized;
+}
+
+static existenceShard_t &existenceShard(const std::string &normalizedPath)
+{
+    return existenceShards[std::hash<std::string>()(normalizedPath) % kExistenceShards];
+}
+
+/*
+ Same as fileUtils::doesFileExist, remembered: see urlUtils::setKnownFiles.
+ */
+static bool doesFileExist(const std::string &path)
+{
+    auto normalizedPath = normalizePath(path);
+    auto &shard = existenceShard(normalizedPath);
+    
+    ++existenceLookups;
+    
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.exists.find(normalizedPath);
+        
+        if (it != shard.exists.end())
+        {
+            return it->second;
+        }
+    }
+    
+    // Looked up unlocked: concurrent checks of the same file may both call stat, harmlessly.
+    // The normalized path is the one looked up, so that the answer is the same as for
+    // known files (see urlUtils::setKnownFiles).
+    ++existenceSystemCalls;
+    bool exists = fileUtils::doesFileExist(normalizedPath.length() > 0 ? normalizedPath : ".");
+    
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.exists[normalizedPath] = exists;
+    
+    return exists;
+}
+
+/*
+ The ids of the elements of a document, parsed once: see urlUtils::setKnownFiles.
+ */
+static std::shared_ptr<const std::set<std::string>> getDocumentIds(const std::string &path)
+{
+    auto normalizedPath = normalizePath(path);
+    auto &shard = existenceShard(normalizedPath);
+    
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.ids.find(normalizedPath);
+        
+        if (it != shard.ids.end())
+        {
+            return it->second;
+        }
+    }
+    
+    // Parsed unlocked, like doesFileExist: documents linked to from many others are parsed
+    // once per search, not once per link.
+    auto ids = std::make_shared<std::set<std::string>>();
+    fileUtils::fileBuffer file(normalizedPath);
+    
+    if (file.isValid())
+    {
+        auto tree = htmlUtils::parseHtmlText(stringUtils::trimmed(file.data(), file.size()));
+        
+        for (auto &element : htmlUtils::extractElementsMatchingPatternFromTree(tree, "", {{"id", ""}}))
+        {
+            ids->insert(element.attributes.at("id"));
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.ids[normalizedPath] = ids;
+    
+    return ids;
+}
+
+urlState urlUtils::checkUrlRelativeToPath(const std::string &url, const std::string &pwd, const elementsTree_t &html)
+{
+    // Foud kinds of url:
+    // Website
+    if (url.substr(0, 4).compare("http") == 0 || url.substr(0, 3).compare("www") == 0)
+    {
+        switch (curlUtils::checkWebsite(url))
+        {
+            case WEBSITE_OK:
+                return URL_VALID;
+            case WEBSITE_TIMED_OUT:
+                return URL_TIMED_OUT;
+            default:
+                return URL_BROKEN;
+        }
+    }
+    
+    return urlUtils::isUrlValidRelativeToPath(url, pwd, html) ? URL_VALID : URL_BROKEN;
+}
 
 bool urlUtils::isUrlValidRelativeToPath(const std::string &url, const std::string &pwd, const elementsTree_t &html)
 {
@@ -59,7 +217,7 @@ bool urlUtils::isUrlValidRelativeToPath(const std::string &url, const std::strin
     {
         std::string pathRelativeToExecutable = pwd + "/" + url;
         pathRelativeToExecutable = stringUtils::replaceAllOccurrencies(pathRelativeToExecutable, "%20", " ");
-        available = fileUtils::doesFileExist(pathRelativeToExecutable);
+        available = doesFileExist(pathRelativeToExecutable);
     }
     else
     {
@@ -73,18 +231,68 @@ bool urlUtils::isUrlValidRelativeToPath(const std::string &url, const std::strin
         
         std::string itemId = url.substr(hashIdx + 1, url.length() - hashIdx - 1);
         
-        available = fileUtils::doesFileExist(linkPath);
+        available = doesFileExist(linkPath);
         
         // Do not look for anchor if file does not exist
         if (available)
         {
-            std::ifstream ifs(linkPath);
-            std::string str((std::istreambuf_iterator<char>(ifs)),
-                            std::istreambuf_iterator<char>());
-            
-            available = str.find(itemId) != std::string::npos;
+            available = getDocumentIds(linkPath)->count(itemId) > 0;
         }
     }
     
     return available;
 }
+
+std::string urlUtils::resolveLocalPath(const std::string &url, const std::string &documentPath)
+{
+    if (url.length() == 0 || url.front() == '#' || url.front() == '/' || url.find(':') != std::string::npos ||
+        url.substr(0, 3).compare("www") == 0)
+    {
+        return "";
+    }
+    
+    std::string target = url.substr(0, url.find_first_of("#?"));
+    target = stringUtils::replaceAllOccurrencies(target, "%20", " ");
+    
+    // Resolved against the directory of the document as existence checks are, so that the
+    // link graph and the existence cache agree on paths.
+    auto resolved = normalizePath(fileUtils::getParentDirectory(documentPath) + "/" + target);
+    
+    if (resolved.length() == 0 || resolved.compare("..") == 0 || resolved.compare(0, 3, "../") == 0)
+    {
+        return "";
+    }
+    
+    return "./" + resolved;
+}
+
+void urlUtils::setKnownFiles(const std::string &root, const std::vector<std::string> &paths)
+{
+    for (auto &shard : existenceShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.exists.clear();
+        shard.ids.clear();
+    }
+    
+    existenceLookups = 0;
+    existenceSystemCalls = 0;
+    
+    for (auto &path : paths)
+    {
+        auto normalizedPath = normalizePath(root + "/" + path);
+        auto &shard = existenceShard(normalizedPath);
+        
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.exists[normalizedPath] = true;
+    }
+}
+
+existenceStatistics_t urlUtils::existenceStatistics()
+{
+    existenceStatistics_t statistics;
+    statistics.lookups = existenceLookups;
+    statistics.systemCalls = existenceSystemCalls;
+    
+    return statistics;
+}
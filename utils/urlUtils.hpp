@@ -30,11 +30,36 @@
 #define urlUtils_hpp
 
 #include <string>
+#include <vector>
 
 #include "htmlUtils.hpp"
 
+enum urlState
+{
+    URL_VALID,
+    URL_BROKEN,
+    URL_TIMED_OUT
+};
+
+struct existenceStatistics_t
+{
+    size_t lookups, systemCalls;
+};
+
 namespace urlUtils
 {
+    /*
+     @brief: given a url string, return whether it is valid, broken, or whether it
+            could not be checked in time.
+     
+     @param `url` See isUrlValidRelativeToPath.
+     @param `pwd` See isUrlValidRelativeToPath.
+     @param `html` See isUrlValidRelativeToPath.
+     
+     @return urlState.
+     */
+    urlState checkUrlRelativeToPath(const std::string &url, const std::string &pwd, const elementsTree_t &html);
+    
     /*
      @brief: given a url string, return whether it is valid or not.
      
@@ -49,6 +74,43 @@ namespace urlUtils
      @return bool.
      */
     bool isUrlValidRelativeToPath(const std::string &url, const std::string &pwd, const elementsTree_t &html);
+    
+    /*
+     @brief: given a link found in a document, return the path of the local file it points to,
+            in the form of the walked paths (e.g. "./a/b.html"). Anchors and queries are dropped.
+     
+     @param `url` The link, as written in the document.
+     @param `documentPath` The path to the document, e.g. "./a/index.html".
+     
+     @return std::string. Empty for websites, other schemes, anchors inside the document, and
+            paths outside of the tree.
+     */
+    std::string resolveLocalPath(const std::string &url, const std::string &documentPath);
+    
+    /*
+     @brief: set the files known to exist, usually those found by discovery: links to them are
+            checked without any system call. Other local targets are looked up with stat once,
+            and the ids of documents linked to with an anchor are parsed once, then both are
+            remembered until the next call. Paths are compared and looked up once "." and ".."
+            are resolved, without following symbolic links, as browsers resolve links: from
+            "link/../a.html", where "link" is a symbolic link to a directory, "a.html" is
+            looked for next to "link", not next to its target.
+            Also starts existenceStatistics over: it is called once per search.
+     
+     @param `root` The directory `paths` are relative to, as in the `pwd` of the checks.
+     @param `paths` The files, relative to `root` (e.g. "./a/b.html").
+     
+     @return void.
+     */
+    void setKnownFiles(const std::string &root, const std::vector<std::string> &paths);
+    
+    /*
+     @brief: return how many local link targets were looked up since setKnownFiles, and how
+            many of them took a system call.
+     
+     @return existenceStatistics_t.
+     */
+    existenceStatistics_t existenceStatistics();
 }
 
 #endif /* urlUtils_hpp */
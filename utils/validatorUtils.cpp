@@ -0,0 +1,743 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <unordered_map>
+
+#include "cacheUtils.hpp"
+#include "cancelUtils.hpp"
+#include "curlUtils.hpp"
+#include "fileUtils.hpp"
+#include "jsonUtils.hpp"
+#include "ledgerUtils.hpp"
+#include "stringUtils.hpp"
+#include "threadUtils.hpp"
+#include "validatorUtils.hpp"
+
+// Start gently: the limiter finds the capacity of the service by itself.
+#define kInitialConcurrency 2
+#define kMaximumConcurrency 64
+
+// Attempts per document when the answers are empty, truncated or unparseable, and the
+// upper bound of the (jittered) wait before the first retry, doubled at each retry.
+#define kMaximumAttempts 3
+#define kRetryBaseDelay 1.0
+
+// Latencies the hedging delay (their 95th percentile) is computed on, and the minimum
+// number of them before hedging at all.
+#define kLatencyWindow 256
+#define kHedgeMinimumSamples 20
+
+// Smaller documents go faster uncompressed than through gzip.
+#define kCompressionMinimumBytes 8192
+
+typedef std::chrono::steady_clock steadyClock_t;
+
+static std::mutex backendMutex;
+static std::shared_ptr<validatorUtils::validatorBackend> currentBackend;
+
+// Validations currently running, keyed by cache key, and the counters of the requests they saved.
+static std::mutex inFlightMutex;
+static std::unordered_map<std::string, std::vector<validationCallback_t>> inFlight;
+static dedupStatistics_t dedup;
+static std::set<uint64_t> deferredHashes;
+
+/*
+ Return the value below which `fraction` of the values fall (nearest rank).
+ */
+static double percentile(std::vector<double> values, double fraction)
+{
+    if (values.size() == 0)
+    {
+        return 0;
+    }
+    
+    size_t rank = std::max<size_t>(1, (size_t)std::ceil(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + rank - 1, values.end());
+    
+    return values[rank - 1];
+}
+
+static problem_t makeProblem(const std::string &type, const std::string &message, const std::string &extract, ssize_t line)
+{
+    problem_t problem;
+    
+    problem.type = type;
+    problem.message = message;
+    problem.extract = extract;
+    problem.firstLine = line;
+    problem.firstColumn = -1;
+    problem.lastLine = line;
+    problem.lastColumn = -1;
+    
+    return problem;
+}
+
+validatorUtils::validatorBackend::validatorBackend() : stats()
+{
+}
+
+void validatorUtils::validatorBackend::validate(const std::string &path, const document_t &document, const validationCallback_t &callback)
+{
+    dispatch([this, &path, &document, callback]() {
+        auto begin = steadyClock_t::now();
+        
+        {
+            std::lock_guard<std::mutex> lock(statisticsMutex);
+            
+            if (stats.requests == 0)
+            {
+                firstRequest = begin;
+            }
+            
+            ++stats.requests;
+        }
+        
+        auto result = submit(path, document);
+        
+        auto end = steadyClock_t::now();
+        double latency = std::chrono::duration<double>(end - begin).count();
+        
+        {
+            std::lock_guard<std::mutex> lock(statisticsMutex);
+            
+            if (result.status != VALIDATION_OK)
+            {
+                ++stats.failures;
+            }
+            
+            stats.totalLatency += latency;
+            stats.maxLatency = std::max(stats.maxLatency, latency);
+            latencies.push_back(latency);
+            stats.elapsed = std::max(stats.elapsed, std::chrono::duration<double>(end - firstRequest).count());
+        }
+        
+        callback(result);
+    });
+}
+
+validatorStatistics_t validatorUtils::validatorBackend::statistics() const
+{
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    
+    auto ret = stats;
+    ret.p50Latency = percentile(latencies, 0.5);
+    ret.p95Latency = percentile(latencies, 0.95);
+    ret.p99Latency = percentile(latencies, 0.99);
+    
+    return ret;
+}
+
+void validatorUtils::validatorBackend::resetStatistics()
+{
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    
+    stats = validatorStatistics_t();
+    latencies.clear();
+}
+
+void validatorUtils::validatorBackend::recordBytesSent(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    stats.bytesSent += bytes;
+}
+
+void validatorUtils::validatorBackend::dispatch(task_t task)
+{
+    threadUtils::sharedPool().submit(std::move(task));
+}
+
+validatorUtils::remoteValidator::remoteValidator(const std::string &url, bool compress, const std::string &hedgeUrl) : url(url), hedgeUrl(hedgeUrl), compress(compress), retries(0), hedged(0), hedgeWins(0), limiter(kInitialConcurrency, 1, kMaximumConcurrency), health(healthUtils::monitor(url)), breakerBaseline(health.statistics())
+{
+}
+
+std::string validatorUtils::remoteValidator::name() const
+{
+    return url;
+}
+
+std::string validatorUtils::remoteValidator::endpoint() const
+{
+    return url;
+}
+
+validatorStatistics_t validatorUtils::remoteValidator::statistics() const
+{
+    auto stats = validatorBackend::statistics();
+    auto limiterStatistics = limiter.statistics();
+    
+    stats.concurrencyLimit = limiterStatistics.limit;
+    stats.peakConcurrency = limiterStatistics.peakInFlight;
+    stats.backoffs = limiterStatistics.backoffs;
+    
+    auto breakerStatistics = health.statistics();
+    
+    stats.breakerOpened = breakerStatistics.opened - breakerBaseline.opened;
+    stats.rejected = breakerStatistics.rejected - breakerBaseline.rejected;
+    
+    stats.retries = retries;
+    stats.hedged = hedged;
+    stats.hedgeWins = hedgeWins;
+    
+    return stats;
+}
+
+void validatorUtils::remoteValidator::resetStatistics()
+{
+    validatorBackend::resetStatistics();
+    limiter.resetStatistics();
+    
+    breakerBaseline = health.statistics();
+    retries = 0;
+    hedged = 0;
+    hedgeWins = 0;
+}
+
+void validatorUtils::remoteValidator::dispatch(task_t task)
+{
+    limiter.schedule(std::move(task));
+}
+
+double validatorUtils::remoteValidator::hedgeDelay()
+{
+    std::lock_guard<std::mutex> lock(latenciesMutex);
+    
+    // Too few answers to tell slow ones apart.
+    if (hedgeUrl.length() == 0 || recentLatencies.size() < kHedgeMinimumSamples)
+    {
+        return -1;
+    }
+    
+    return percentile(std::vector<double>(recentLatencies.begin(), recentLatencies.end()), 0.95);
+}
+
+validationResult_t validatorUtils::remoteValidator::submit(const std::string &, const document_t &document)
+{
+    validationResult_t result;
+    int httpStatus = 0;
+    
+    // The limiter already reserved a slot for this request (see dispatch).
+    // An open breaker fails fast, without even waiting for a probe.
+    if (!health.allowRequest())
+    {
+        limiter.abandon();
+        result.status = VALIDATION_UNAVAILABLE;
+        return result;
+    }
+    
+    // The status is cached: only the first request of a run may wait for a probe.
+    auto endpointStatus = health.status();
+    
+    if (endpointStatus != ENDPOINT_HEALTHY)
+    {
+        limiter.abandon();
+        health.abandonRequest();
+        result.status = endpointStatus == ENDPOINT_THROTTLED ? VALIDATION_THROTTLED : VALIDATION_UNAVAILABLE;
+        return result;
+    }
+    
+    // The bytes hashed by the read stage, which the answer is cached under: the file is not
+    // read again. Only documents read without needsFile() lack them.
+    if (!document.file)
+    {
+        limiter.abandon();
+        health.abandonRequest();
+        result.status = VALIDATION_FAILED;
+        return result;
+    }
+    
+    auto &file = *document.file;
+    
+    bool overloaded = false;
+    double latency = 0;
+    
+    for (size_t attempt = 0; attempt < kMaximumAttempts; ++attempt)
+    {
+        if (attempt > 0)
+        {
+            // Out of budget: the document is checked again by a later search.
+            if (!ledgerUtils::reserveRequest(url))
+            {
+                break;
+            }
+            
+            // Full jitter: retries of documents which failed together do not come back together.
+            static thread_local std::mt19937 generator(std::random_device{}());
+            std::uniform_real_distribution<double> distribution(0, kRetryBaseDelay * (1 << (attempt - 1)));
+            
+            if (!cancelUtils::sleepFor(distribution(generator)))
+            {
+                ledgerUtils::releaseRequest(url);
+                break;
+            }
+            
+            ++retries;
+        }
+        
+        ledgerUtils::recordRequest(url);
+        
+        auto begin = steadyClock_t::now();
+        bool compressed = compress && file.size() >= kCompressionMinimumBytes;
+        double delay = hedgeDelay();
+        bool hedgeSent = false, hedgeAnswered = false;
+        size_t bytesSent = 0;
+        
+        // The hedge may not be sent at all, but must fit in the budget in case it is.
+        if (delay >= 0 && !ledgerUtils::reserveRequest(hedgeUrl))
+        {
+            delay = -1;
+        }
+        
+        std::string response = delay < 0 ?
+        curlUtils::validateHTML(file.data(), file.size(), url, compressed, httpStatus, bytesSent) :
+        curlUtils::hedgedValidateHTML(file.data(), file.size(), url, hedgeUrl, delay, compressed, httpStatus, hedgeSent, hedgeAnswered, bytesSent);
+        
+        recordBytesSent(bytesSent);
+        
+        if (hedgeSent)
+        {
+            ledgerUtils::recordRequest(hedgeUrl);
+            ++hedged;
+        }
+        else if (delay >= 0)
+        {
+            ledgerUtils::releaseRequest(hedgeUrl);
+        }
+        
+        if (compressed && (httpStatus == 400 || httpStatus == 415))
+        {
+            // Refused: send everything uncompressed from now on.
+            compress = false;
+            
+            if (ledgerUtils::reserveRequest(url))
+            {
+                ledgerUtils::recordRequest(url);
+                response = curlUtils::validateHTML(file.data(), file.size(), url, false, httpStatus, bytesSent);
+                recordBytesSent(bytesSent);
+                hedgeAnswered = false;
+            }
+        }
+        
+        latency = std::chrono::duration<double>(steadyClock_t::now() - begin).count();
+        
+        if (hedgeAnswered)
+        {
+            ++hedgeWins;
+        }
+        
+        // Requests skipped because of the run deadline tell nothing about the service.
+        overloaded = overloaded || (limiterUtils::isOverloadStatus(httpStatus) && !hedgeAnswered && !cancelUtils::isCancelled());
+        
+        result.problems.clear();
+        
+        if (curlUtils::isTimeoutResponse(response))
+        {
+            result.status = VALIDATION_TIMED_OUT;
+        }
+        else if (validatorUtils::parseResponse(response, result.problems))
+        {
+            result.status = VALIDATION_OK;
+        }
+        else
+        {
+            result.status = VALIDATION_FAILED;
+        }
+        
+        if (result.status == VALIDATION_OK)
+        {
+            std::lock_guard<std::mutex> lock(latenciesMutex);
+            
+            recentLatencies.push_back(latency);
+            
+            if (recentLatencies.size() > kLatencyWindow)
+            {
+                recentLatencies.pop_front();
+            }
+        }
+        
+        // Only empty, truncated or unparseable answers are worth another try: timeouts
+        // already took the longest possible time.
+        if (result.status != VALIDATION_FAILED || cancelUtils::isCancelled())
+        {
+            break;
+        }
+    }
+    
+    limiter.release(latency, overloaded);
+    
+    if (cancelUtils::isCancelled())
+    {
+        // Tells nothing about the service either.
+        health.abandonRequest();
+    }
+    else if (result.status == VALIDATION_OK && !limiterUtils::isOverloadStatus(httpStatus))
+    {
+        health.recordSuccess();
+    }
+    else
+    {
+        health.recordFailure();
+    }
+    
+    return result;
+}
+
+std::string validatorUtils::offlineValidator::name() const
+{
+    return "offline";
+}
+
+std::string validatorUtils::offlineValidator::endpoint() const
+{
+    return "";
+}
+
+validationResult_t validatorUtils::offlineValidator::submit(const std::string &, const document_t &document)
+{
+    validationResult_t result;
+    result.status = VALIDATION_OK;
+    
+    auto &problems = result.problems;
+    auto &text = *document.plaintext;
+    auto &tree = *document.tree;
+    
+    // Messages are worded like the Nu Html Checker ones, so results look alike across backends.
+    if (stringUtils::lowercase(text.substr(0, 14)).compare("<!doctype html") != 0)
+    {
+        problems.push_back(makeProblem("error", "Start tag seen without seeing a doctype first. Expected \"<!DOCTYPE html>\".", text.substr(0, text.find('>') + 1), 1));
+    }
+    
+    auto html = htmlUtils::extractFirstElementMatchingPatternFromTree(tree, "html", {});
+    
+    if (html.tag.length() > 0 && html.attributes.count("lang") == 0)
+    {
+        problems.push_back(makeProblem("info", "Consider adding a \"lang\" attribute to the \"html\" start tag to declare the language of this document.", "", stringUtils::firstLineOccurrence(text, "<html")));
+    }
+    
+    if (htmlUtils::extractElementsMatchingPatternFromTree(tree, "title", {}).size() == 0)
+    {
+        problems.push_back(makeProblem("error", "Element \"head\" is missing a required instance of child element \"title\".", "", -1));
+    }
+    
+    for (auto &image : htmlUtils::extractElementsMatchingPatternFromTree(tree, "img", {}))
+    {
+        if (image.attributes.count("alt") == 0)
+        {
+            // The representation of self-closing elements may lack the closing bracket.
+            auto closingIdx = image.stringRepresentation.find('>');
+            auto extract = image.stringRepresentation.substr(0, closingIdx == std::string::npos ? closingIdx : closingIdx + 1);
+            problems.push_back(makeProblem("error", "An \"img\" element must have an \"alt\" attribute, except under certain conditions.", extract, stringUtils::firstLineOccurrence(text, extract)));
+        }
+    }
+    
+    std::unordered_map<std::string, size_t> idsCount;
+    
+    for (auto &element : htmlUtils::extractElementsMatchingPatternFromTree(tree, "", {{"id", ""}}))
+    {
+        auto &id = element.attributes.at("id");
+        
+        if (++idsCount[id] == 2)
+        {
+            problems.push_back(makeProblem("error", "Duplicate ID \"" + id + "\".", "id=\"" + id + "\"", -1));
+        }
+    }
+    
+    return result;
+}
+
+std::shared_ptr<validatorUtils::validatorBackend> validatorUtils::makeBackend(const std::string &specification, bool compress, const std::string &hedgeUrl)
+{
+    if (stringUtils::lowercase(specification).compare("offline") == 0)
+    {
+        return std::make_shared<offlineValidator>();
+    }
+    
+    return std::make_shared<remoteValidator>(specification, compress, hedgeUrl);
+}
+
+void validatorUtils::validateDocument(const std::string &path, const document_t &document, const validationCallback_t &callback)
+{
+    auto backend = validatorUtils::backend();
+    auto cacheKey = cacheUtils::makeKey(backend->name(), document.contentHash);
+    
+    validationResult_t result;
+    result.status = VALIDATION_OK;
+    bool cached, deferred = false;
+    
+    {
+        std::lock_guard<std::mutex> lock(inFlightMutex);
+        
+        ++dedup.documents;
+        
+        auto entry = inFlight.find(cacheKey);
+        
+        if (entry != inFlight.end())
+        {
+            // An identical document is being validated: just wait for its results.
+            ++dedup.coalesced;
+            entry->second.push_back(callback);
+            return;
+        }
+        
+        // Checked under the lock: a validation finishing meanwhile stores its results before
+        // leaving `inFlight`, so they are found in either place.
+        cached = cacheUtils::lookup(cacheKey, result.problems);
+        
+        if (cached)
+        {
+            ++dedup.cached;
+        }
+        else if (deferredHashes.count(document.contentHash) > 0)
+        {
+            ++dedup.deferred;
+            deferred = true;
+        }
+        else
+        {
+            ++dedup.sent;
+            inFlight[cacheKey].push_back(callback);
+        }
+    }
+    
+    if (cached || deferred)
+    {
+        result.status = cached ? VALIDATION_OK : VALIDATION_DEFERRED;
+        callback(result);
+        return;
+    }
+    
+    backend->validate(path, document, [cacheKey](const validationResult_t &result) {
+        // Failed validations would be cached as documents without problems.
+        if (result.status == VALIDATION_OK)
+        {
+            cacheUtils::store(cacheKey, result.problems);
+        }
+        
+        std::vector<validationCallback_t> callbacks;
+        
+        {
+            std::lock_guard<std::mutex> lock(inFlightMutex);
+            callbacks.swap(inFlight[cacheKey]);
+            inFlight.erase(cacheKey);
+        }
+        
+        for (auto &callback : callbacks)
+        {
+            callback(result);
+        }
+    });
+}
+
+void validatorUtils::setDeferred(const std::set<uint64_t> &contentHashes)
+{
+    std::lock_guard<std::mutex> lock(inFlightMutex);
+    deferredHashes = contentHashes;
+}
+
+dedupStatistics_t validatorUtils::dedupStatistics()
+{
+    std::lock_guard<std::mutex> lock(inFlightMutex);
+    return dedup;
+}
+
+void validatorUtils::setBackend(const std::shared_ptr<validatorBackend> &backend)
+{
+    {
+        std::lock_guard<std::mutex> lock(inFlightMutex);
+        dedup = dedupStatistics_t();
+        deferredHashes.clear();
+    }
+    
+    std::lock_guard<std::mutex> lock(backendMutex);
+    currentBackend = backend;
+}
+
+std::shared_ptr<validatorUtils::validatorBackend> validatorUtils::backend()
+{
+    std::lock_guard<std::mutex> lock(backendMutex);
+    return currentBackend;
+}
+
+bool validatorUtils::needsFile(uint64_t contentHash)
+{
+    auto backend = validatorUtils::backend();
+    
+    // Offline backends check the parsed document.
+    return backend->endpoint().length() > 0 && !cacheUtils::contains(cacheUtils::makeKey(backend->name(), contentHash));
+}
+
+/*
+ Decode a message of the validator's answer into a problem. Unknown fields are skipped.
+ */
+static bool readMessage(jsonUtils::reader &reader, problem_t &problem)
+{
+    bool hasType = false, hasMessage = false, hasExtract = false;
+    bool hasFirstLine = false, hasFirstColumn = false;
+    int64_t firstLine = -1, firstColumn = -1, lastLine = -1, lastColumn = -1;
+    
+    std::string key;
+    
+    if (!reader.beginObject())
+    {
+        return false;
+    }
+    
+    while (reader.nextKey(key))
+    {
+        bool ok;
+        
+        if (key.compare("type") == 0)
+        {
+            ok = hasType = reader.readString(problem.type);
+        }
+        else if (key.compare("message") == 0)
+        {
+            ok = hasMessage = reader.readString(problem.message);
+        }
+        else if (key.compare("extract") == 0)
+        {
+            ok = hasExtract = reader.readString(problem.extract);
+        }
+        else if (key.compare("lastLine") == 0)
+        {
+            ok = reader.readInteger(lastLine);
+        }
+        else if (key.compare("lastColumn") == 0)
+        {
+            ok = reader.readInteger(lastColumn);
+        }
+        else if (key.compare("firstLine") == 0)
+        {
+            ok = hasFirstLine = reader.readInteger(firstLine);
+        }
+        else if (key.compare("firstColumn") == 0)
+        {
+            ok = hasFirstColumn = reader.readInteger(firstColumn);
+        }
+        else
+        {
+            ok = reader.skipValue();
+        }
+        
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    
+    if (reader.failed())
+    {
+        return false;
+    }
+    
+    if (!hasType)
+    {
+        problem.type = "unknown";
+    }
+    
+    if (!hasMessage)
+    {
+        problem.message = "No message";
+    }
+    
+    if (!hasExtract)
+    {
+        problem.extract = "No extract";
+    }
+    
+    problem.lastLine = lastLine;
+    problem.lastColumn = lastColumn;
+    problem.firstLine = hasFirstLine ? firstLine : lastLine;
+    problem.firstColumn = hasFirstColumn ? firstColumn : lastColumn;
+    
+    return true;
+}
+
+bool validatorUtils::parseResponse(const std::string &response, std::vector<problem_t> &problems)
+{
+    // Empty answers and curl errors carry no messages. Do not let them reach the json parser.
+    if (response.length() == 0 || response.front() != '{')
+    {
+        return false;
+    }
+    
+    // Decoded as a stream, straight into problems: answers may hold thousands of messages,
+    // and a json DOM of them would cost an allocation per field.
+    jsonUtils::reader reader(response);
+    std::string key;
+    size_t initialSize = problems.size();
+    
+    if (!reader.beginObject())
+    {
+        return false;
+    }
+    
+    while (reader.nextKey(key))
+    {
+        if (key.compare("messages") != 0)
+        {
+            if (!reader.skipValue())
+            {
+                break;
+            }
+            
+            continue;
+        }
+        
+        if (!reader.beginArray())
+        {
+            break;
+        }
+        
+        while (reader.nextElement())
+        {
+            problems.emplace_back();
+            
+            if (!readMessage(reader, problems.back()))
+            {
+                break;
+            }
+        }
+        
+        if (reader.failed())
+        {
+            break;
+        }
+    }
+    
+    // Truncated or malformed answers must not pass for documents without problems.
+    if (reader.failed() || !reader.atEnd())
+    {
+        problems.resize(initialSize);
+        return false;
+    }
+    
+    return true;
+}
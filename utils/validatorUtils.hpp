@@ -0,0 +1,291 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef validatorUtils_hpp
+#define validatorUtils_hpp
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "healthUtils.hpp"
+#include "htmlUtils.hpp"
+#include "limiterUtils.hpp"
+#include "threadUtils.hpp"
+
+enum validationStatus
+{
+    VALIDATION_OK,
+    VALIDATION_TIMED_OUT,
+    VALIDATION_FAILED,
+    VALIDATION_DEFERRED, // Not sent, to stay within the request budget
+    VALIDATION_UNAVAILABLE, // Not sent, the service is unreachable or kept failing (see healthUtils)
+    VALIDATION_THROTTLED // Not sent, the service refuses our requests for now
+};
+
+struct validationResult_t
+{
+    validationStatus status;
+    std::vector<problem_t> problems;
+};
+
+typedef std::function<void(const validationResult_t &)> validationCallback_t;
+
+struct dedupStatistics_t
+{
+    size_t documents; // Documents which needed validator results
+    size_t cached; // Served by the persistent cache
+    size_t coalesced; // Served by an identical document validated at the same time
+    size_t sent; // Actually sent to the backend
+    size_t deferred; // Left for a later run by the request budget
+};
+
+struct validatorStatistics_t
+{
+    size_t requests, failures, bytesSent; // Bytes uploaded, retries and hedges included
+    double totalLatency, maxLatency; // Seconds
+    double p50Latency, p95Latency, p99Latency; // Seconds, per document
+    double elapsed; // Seconds between the first request and the last answer
+    double concurrencyLimit; // Adaptive limit of concurrent requests, 0 if unlimited
+    size_t peakConcurrency, backoffs;
+    size_t breakerOpened, rejected; // See healthUtils::endpointHealth
+    size_t retries; // Documents sent again after an unusable answer
+    size_t hedged, hedgeWins; // Documents also sent to the hedging endpoint, and answered by it first
+};
+
+namespace validatorUtils
+{
+    /*
+     A service able to validate html documents.
+     Subclasses implement submit(), which runs on a pool worker chosen by dispatch(); validate()
+     wraps it to keep throughput and latency statistics.
+     */
+    class validatorBackend
+    {
+    public:
+        validatorBackend();
+        virtual ~validatorBackend() {}
+        
+        /*
+         @brief: return a human readable name for the backend.
+         
+         @return std::string.
+         */
+        virtual std::string name() const = 0;
+        
+        /*
+         @brief: return the url whose health should be checked before a run, if any.
+         
+         @return std::string. Empty for backends which do not need the network.
+         */
+        virtual std::string endpoint() const = 0;
+        
+        /*
+         @brief: validate a document asynchronously. Safe to call concurrently.
+                `path` and `document` must stay valid until `callback` was called.
+         
+         @param `path` The path to the html document.
+         @param `document` The document, already read and parsed.
+         @param `callback` Called with the results, on a pool worker.
+         
+         @return void.
+         */
+        void validate(const std::string &path, const document_t &document, const validationCallback_t &callback);
+        
+        /*
+         @brief: return the throughput and latency statistics of the backend.
+         
+         @return validatorStatistics_t.
+         */
+        virtual validatorStatistics_t statistics() const;
+        
+        /*
+         @brief: start the statistics over, e.g. for a new run. What the backend learned about
+                its service (e.g. its capacity) is kept.
+         
+         @return void.
+         */
+        virtual void resetStatistics();
+        
+    protected:
+        virtual validationResult_t submit(const std::string &path, const document_t &document) = 0;
+        
+        // Runs the task sending a document. Defaults to the shared pool.
+        virtual void dispatch(task_t task);
+        
+        // Counts bytes actually uploaded, compressed or not, by submit().
+        void recordBytesSent(size_t bytes);
+        
+    private:
+        mutable std::mutex statisticsMutex;
+        validatorStatistics_t stats;
+        std::vector<double> latencies;
+        std::chrono::steady_clock::time_point firstRequest;
+    };
+    
+    /*
+     A Nu Html Checker compatible service (validator.w3.org/nu, a self-hosted vnu.jar, or
+     any local stand-in answering with the same json format).
+     Submissions go through an adaptive concurrency limit, so that the service is used at
+     its real capacity without getting us banned, and through the circuit breaker of the
+     endpoint, so that an outage fails the remaining documents fast. The endpoint is probed
+     before the first request only, so that runs without any request never use the network.
+     Unusable answers (empty, truncated, unparseable) are retried after a jittered backoff.
+     If a second endpoint is given, documents whose answer takes longer than the 95th
+     percentile are also sent there, and the first answer wins.
+     */
+    class remoteValidator : public validatorBackend
+    {
+    public:
+        remoteValidator(const std::string &url, bool compress, const std::string &hedgeUrl);
+        
+        std::string name() const override;
+        std::string endpoint() const override;
+        validatorStatistics_t statistics() const override;
+        void resetStatistics() override;
+        
+    protected:
+        validationResult_t submit(const std::string &path, const document_t &document) override;
+        void dispatch(task_t task) override;
+        
+    private:
+        double hedgeDelay();
+        
+        std::string url, hedgeUrl;
+        std::atomic<bool> compress; // Dropped if the service refuses gzipped bodies
+        std::atomic<size_t> retries, hedged, hedgeWins;
+        
+        std::mutex latenciesMutex;
+        std::deque<double> recentLatencies; // Of the last answers, for hedgeDelay
+        limiterUtils::aimdLimiter limiter;
+        healthUtils::endpointHealth &health;
+        breakerStatistics_t breakerBaseline; // The breaker is shared by every backend of the endpoint, and never reset
+    };
+    
+    /*
+     Validates documents without any network request, against a small set of embedded rules
+     mirroring the most common messages of the Nu Html Checker.
+     */
+    class offlineValidator : public validatorBackend
+    {
+    public:
+        std::string name() const override;
+        std::string endpoint() const override;
+        
+    protected:
+        validationResult_t submit(const std::string &path, const document_t &document) override;
+    };
+    
+    /*
+     @brief: given a backend specification, return the corresponding backend.
+     
+     @param `specification` Either "offline" or the url of a Nu compatible validator.
+     @param `compress` Whether remote validators may gzip big documents.
+     @param `hedgeUrl` The url of a second validator to race slow requests against. May be empty.
+     
+     @return std::shared_ptr<validatorBackend>.
+     */
+    std::shared_ptr<validatorBackend> makeBackend(const std::string &specification, bool compress, const std::string &hedgeUrl);
+    
+    /*
+     @brief: get the validator results of a document asynchronously, using the current backend.
+            Results are looked up by content hash in the persistent cache first. Identical
+            documents validated concurrently are coalesced: only one of them is sent, and
+            the others get its results.
+     
+     @param `path` The path to the html document.
+     @param `document` The document, already read and parsed.
+     @param `callback` Called with the results, either right away or on a pool worker.
+     
+     @return void.
+     */
+    void validateDocument(const std::string &path, const document_t &document, const validationCallback_t &callback);
+    
+    /*
+     @brief: make validateDocument answer VALIDATION_DEFERRED instead of sending documents with
+            these contents, unless their results are cached. Cleared by setBackend.
+     
+     @param `contentHashes` See document_t::contentHash.
+     
+     @return void.
+     */
+    void setDeferred(const std::set<uint64_t> &contentHashes);
+    
+    /*
+     @brief: return how many validator requests were saved since the backend was set.
+     
+     @return dedupStatistics_t.
+     */
+    dedupStatistics_t dedupStatistics();
+    
+    /*
+     @brief: set the backend used by htmlUtils::validateHtml. Also resets dedupStatistics and
+            the deferred documents.
+     
+     @param `backend` The backend to use.
+     
+     @return void.
+     */
+    void setBackend(const std::shared_ptr<validatorBackend> &backend);
+    
+    /*
+     @brief: return the backend used by htmlUtils::validateHtml.
+     
+     @return std::shared_ptr<validatorBackend>.
+     */
+    std::shared_ptr<validatorBackend> backend();
+    
+    /*
+     @brief: given the json answer of a Nu compatible validator, return its messages.
+     
+     @param `response` The json answer.
+     @param `problems` Where to append the messages.
+     
+     @return bool. False if the answer could not be parsed.
+     */
+    bool parseResponse(const std::string &response, std::vector<problem_t> &problems);
+    
+    /*
+     @brief: return whether validating these contents would send them, so that the read stage
+            keeps the bytes it hashed (see document_t::file): the current backend is remote,
+            and has no cached results for them.
+     
+     @param `contentHash` See document_t::contentHash.
+     
+     @return bool.
+     */
+    bool needsFile(uint64_t contentHash);
+}
+
+#endif /* validatorUtils_hpp */
@@ -0,0 +1,438 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "globUtils.hpp"
+#include "threadUtils.hpp"
+#include "walkUtils.hpp"
+
+#ifdef __linux__
+// Entries listed per system call, when they are small.
+#define kDirectoryBufferSize 65536
+
+// As returned by getdents64, which glibc does not declare.
+struct linuxDirent64_t
+{
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+// Ignore files bigger than this are not read.
+#define kMaximumIgnoreFileSize (1 << 20)
+
+/*
+ The patterns of the ignore files of a directory, chained to those of its parents. Shared,
+ read only, by the tasks walking the subdirectories.
+ */
+struct ignoreLayer_t
+{
+    std::shared_ptr<const ignoreLayer_t> parent;
+    size_t baseLength; // Length of the directory path, separator included
+    globUtils::ruleSet rules;
+};
+
+typedef std::shared_ptr<const ignoreLayer_t> ignoreLayerPtr_t;
+
+/*
+ The options of a walk, compiled.
+ */
+struct walkFilter_t
+{
+    const walkOptions_t &options;
+    size_t rootLength; // Length of the root path, separator included
+    globUtils::ruleSet includes, excludes;
+    
+    walkFilter_t(const std::string &root, const walkOptions_t &options) : options(options), rootLength(root.length() + 1)
+    {
+        for (auto &pattern : options.includePatterns)
+        {
+            includes.add(pattern);
+        }
+        
+        for (auto &pattern : options.excludePatterns)
+        {
+            excludes.add(pattern);
+        }
+    }
+};
+
+/*
+ The state shared by the tasks of a walk.
+ */
+struct walkState_t
+{
+    walkState_t(const walkFilter_t &filter, const pathCallback_t &callback, const pathCallback_t &directoryCallback, threadUtils::taskGroup &group) :
+    filter(filter), callback(callback), directoryCallback(directoryCallback), group(group)
+    {
+    }
+    
+    const walkFilter_t &filter;
+    const pathCallback_t &callback;
+    const pathCallback_t &directoryCallback;
+    threadUtils::taskGroup &group;
+    
+    std::mutex visitedMutex;
+    std::set<std::pair<dev_t, ino_t>> visited;
+    
+    // Directories reached through symbolic links, walked after the real ones, so that files
+    // get their real path whenever they have one.
+    std::vector<std::pair<std::string, ignoreLayerPtr_t>> linkedDirectories;
+};
+
+enum entryKind
+{
+    ENTRY_FILE,
+    ENTRY_DIRECTORY,
+    ENTRY_OTHER
+};
+
+/*
+ Return whether a path is ignored: the command line patterns decide first, then the ignore
+ files from the deepest directory up. Within a set of patterns, the last match decides.
+ */
+static bool isIgnored(const std::string &path, const std::string &name, bool isDirectory, const ignoreLayer_t *layer, const walkFilter_t &filter)
+{
+    auto match = filter.excludes.match(path.substr(filter.rootLength), name, isDirectory);
+    
+    for (; match == GLOB_NO_MATCH && layer; layer = layer->parent.get())
+    {
+        match = layer->rules.match(path.substr(layer->baseLength), name, isDirectory);
+    }
+    
+    return match == GLOB_MATCH;
+}
+
+static bool isIncludedFile(const std::string &path, const std::string &name, const walkFilter_t &filter)
+{
+    return filter.includes.empty() || filter.includes.match(path.substr(filter.rootLength), name, false) == GLOB_MATCH;
+}
+
+/*
+ Read the ignore files of a directory. Return the layer of its patterns, or the parent layer
+ when it has none.
+ */
+static ignoreLayerPtr_t readIgnoreFiles(int directoryFd, const std::string &path, const ignoreLayerPtr_t &parent, const walkFilter_t &filter)
+{
+    std::shared_ptr<ignoreLayer_t> layer;
+    
+    for (auto &fileName : filter.options.ignoreFiles)
+    {
+        int fd = openat(directoryFd, fileName.c_str(), O_RDONLY | O_CLOEXEC);
+        
+        if (fd < 0)
+        {
+            continue;
+        }
+        
+        std::string contents;
+        char buffer[4096];
+        ssize_t count;
+        
+        while ((count = read(fd, buffer, sizeof(buffer))) > 0 && contents.length() < kMaximumIgnoreFileSize)
+        {
+            contents.append(buffer, count);
+        }
+        
+        close(fd);
+        
+        if (!layer)
+        {
+            layer = std::make_shared<ignoreLayer_t>();
+            layer->parent = parent;
+            layer->baseLength = path.length() + 1;
+        }
+        
+        layer->rules.addLines(contents);
+    }
+    
+    if (!layer || layer->rules.empty())
+    {
+        return parent;
+    }
+    
+    return layer;
+}
+
+/*
+ Given the type reported by the directory listing, return the kind of the entry, following
+ symbolic links. Only links and unknown types cost a system call.
+ */
+static entryKind entryKindAt(int directoryFd, const char *name, unsigned char type, bool &isLink)
+{
+    isLink = type == DT_LNK;
+    
+    if (type == DT_REG)
+    {
+        return ENTRY_FILE;
+    }
+    
+    if (type == DT_DIR)
+    {
+        return ENTRY_DIRECTORY;
+    }
+    
+    if (type != DT_LNK && type != DT_UNKNOWN)
+    {
+        return ENTRY_OTHER;
+    }
+    
+    struct stat buffer;
+    
+    // Some file systems do not report types at all.
+    if (type == DT_UNKNOWN)
+    {
+        if (fstatat(directoryFd, name, &buffer, AT_SYMLINK_NOFOLLOW) != 0)
+        {
+            return ENTRY_OTHER;
+        }
+        
+        isLink = S_ISLNK(buffer.st_mode);
+    }
+    
+    // Broken links are skipped.
+    if (fstatat(directoryFd, name, &buffer, 0) != 0)
+    {
+        return ENTRY_OTHER;
+    }
+    
+    return S_ISDIR(buffer.st_mode) ? ENTRY_DIRECTORY : S_ISREG(buffer.st_mode) ? ENTRY_FILE : ENTRY_OTHER;
+}
+
+static void walkDirectory(const std::string &path, const ignoreLayerPtr_t &parentLayer, walkState_t &state);
+
+static void visitEntry(int directoryFd, const std::string &directoryPath, const char *name, unsigned char type, const ignoreLayerPtr_t &layer, walkState_t &state)
+{
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+    {
+        return;
+    }
+    
+    bool isLink;
+    auto kind = entryKindAt(directoryFd, name, type, isLink);
+    
+    if (kind == ENTRY_OTHER)
+    {
+        return;
+    }
+    
+    bool isDirectory = kind == ENTRY_DIRECTORY;
+    std::string path = directoryPath + "/" + name;
+    
+    // Most files are rejected by the include patterns alone.
+    if (!isDirectory && !isIncludedFile(path, name, state.filter))
+    {
+        return;
+    }
+    
+    // Ignored directories are pruned, their subtree is never listed.
+    if (isIgnored(path, name, isDirectory, layer.get(), state.filter))
+    {
+        return;
+    }
+    
+    if (!isDirectory)
+    {
+        state.callback(path);
+    }
+    else if (isLink)
+    {
+        std::lock_guard<std::mutex> lock(state.visitedMutex);
+        state.linkedDirectories.push_back(std::make_pair(path, layer));
+    }
+    else
+    {
+        state.group.run([path, layer, &state]() {
+            walkDirectory(path, layer, state);
+        });
+    }
+}
+
+static void walkDirectory(const std::string &path, const ignoreLayerPtr_t &parentLayer, walkState_t &state)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    
+    if (fd < 0)
+    {
+        return;
+    }
+    
+    struct stat buffer;
+    
+    if (fstat(fd, &buffer) != 0)
+    {
+        close(fd);
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(state.visitedMutex);
+        
+        if (!state.visited.insert(std::make_pair(buffer.st_dev, buffer.st_ino)).second)
+        {
+            // Already reached through another path (e.g. a link loop).
+            close(fd);
+            return;
+        }
+    }
+    
+    if (state.directoryCallback)
+    {
+        state.directoryCallback(path);
+    }
+    
+    auto layer = readIgnoreFiles(fd, path, parentLayer, state.filter);
+    
+#ifdef __linux__
+    char entries[kDirectoryBufferSize];
+    long count;
+    
+    while ((count = syscall(SYS_getdents64, fd, entries, sizeof(entries))) > 0)
+    {
+        for (long offset = 0; offset < count;)
+        {
+            auto entry = (linuxDirent64_t *)(entries + offset);
+            visitEntry(fd, path, entry->d_name, entry->d_type, layer, state);
+            offset += entry->d_reclen;
+        }
+    }
+    
+    close(fd);
+#else
+    // fdopendir takes ownership of the descriptor.
+    DIR *directory = fdopendir(fd);
+    
+    if (!directory)
+    {
+        close(fd);
+        return;
+    }
+    
+    while (struct dirent *entry = readdir(directory))
+    {
+        visitEntry(fd, path, entry->d_name, entry->d_type, layer, state);
+    }
+    
+    closedir(directory);
+#endif
+}
+
+void walkUtils::walk(const std::string &root, const walkOptions_t &options, const pathCallback_t &callback, const pathCallback_t &directoryCallback)
+{
+    walkFilter_t filter(root, options);
+    threadUtils::taskGroup group(threadUtils::sharedPool());
+    walkState_t state(filter, callback, directoryCallback, group);
+    
+    group.run([&root, &state]() {
+        walkDirectory(root, nullptr, state);
+    });
+    
+    group.wait();
+    
+    // Each round may find links to walk in the next one. Loops end on visited directories.
+    while (state.linkedDirectories.size() > 0)
+    {
+        std::vector<std::pair<std::string, ignoreLayerPtr_t>> linkedDirectories;
+        linkedDirectories.swap(state.linkedDirectories);
+        
+        std::sort(linkedDirectories.begin(), linkedDirectories.end());
+        
+        for (auto &linked : linkedDirectories)
+        {
+            group.run([&linked, &state]() {
+                walkDirectory(linked.first, linked.second, state);
+            });
+        }
+        
+        group.wait();
+    }
+}
+
+bool walkUtils::isIncluded(const std::string &root, const std::string &path, const walkOptions_t &options)
+{
+    walkFilter_t filter(root, options);
+    auto nameIdx = path.rfind('/');
+    
+    if (path.compare(0, filter.rootLength, root + "/") != 0 || nameIdx == std::string::npos ||
+        !isIncludedFile(path, path.substr(nameIdx + 1), filter))
+    {
+        return false;
+    }
+    
+    // Each directory from the root down adds its ignore files, unless it is ignored itself.
+    ignoreLayerPtr_t layer;
+    size_t directoryEndIdx = root.length();
+    
+    while (true)
+    {
+        auto directory = path.substr(0, directoryEndIdx);
+        int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        
+        if (fd < 0)
+        {
+            return false;
+        }
+        
+        layer = readIgnoreFiles(fd, directory, layer, filter);
+        close(fd);
+        
+        auto nextEndIdx = path.find('/', directoryEndIdx + 1);
+        
+        if (nextEndIdx == std::string::npos)
+        {
+            break;
+        }
+        
+        auto name = path.substr(directoryEndIdx + 1, nextEndIdx - directoryEndIdx - 1);
+        
+        if (isIgnored(path.substr(0, nextEndIdx), name, true, layer.get(), filter))
+        {
+            return false;
+        }
+        
+        directoryEndIdx = nextEndIdx;
+    }
+    
+    return !isIgnored(path, path.substr(nameIdx + 1), false, layer.get(), filter);
+}
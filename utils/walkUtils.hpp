@@ -0,0 +1,82 @@
+/*
+ MIT License
+ 
+ Copyright (c) 2016 Jason Naldi
+ 
+ - direct contact: dev@jasonnaldi.com
+ - web: https://jasonnaldi.com
+ - github: https://github.com/jasonnaldi
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#ifndef walkUtils_hpp
+#define walkUtils_hpp
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct walkOptions_t
+{
+    std::vector<std::string> includePatterns; // Files are reported when one matches (globUtils, "!" excludes again). Empty for all files.
+    std::vector<std::string> excludePatterns; // Ignore patterns for the whole tree, overriding the ignore files
+    std::vector<std::string> ignoreFiles; // Names of the per-directory ignore files (e.g. ".gitignore")
+};
+
+typedef std::function<void(const std::string &path)> pathCallback_t;
+
+namespace walkUtils
+{
+    /*
+     @brief: walk a directory tree in parallel on the shared pool, and report every file
+            matching the options as soon as it is found. Directories are listed with
+            getdents64 on Linux (readdir elsewhere) and entries are typed relative to their
+            directory (fstatat), without building a second path. Symbolic links to
+            directories are followed after the real directories, and every directory is
+            visited once (by device and inode): files get their real path whenever they have
+            one, and link loops end.
+            Paths are filtered as by git: the ignore files of a directory apply to everything
+            below it, deeper files override shallower ones, and ignored directories are never
+            opened.
+     
+     @param `root` The directory to walk. Reported paths start with it (e.g. "./a/b.html").
+     @param `options` See walkOptions_t.
+     @param `callback` Called with each matching path, concurrently from pool workers.
+     @param `directoryCallback` If set, called with each directory walked, the root included.
+     
+     @return void. Returns once the whole tree was walked and every callback returned.
+     */
+    void walk(const std::string &root, const walkOptions_t &options, const pathCallback_t &callback, const pathCallback_t &directoryCallback = nullptr);
+    
+    /*
+     @brief: return whether walk would report a file, reading the ignore files of the
+            directories between the root and the file. Meant for single paths (e.g. a file
+            just created), not for whole trees.
+     
+     @param `root` The root of the walk.
+     @param `path` The path to the file, starting with the root.
+     @param `options` See walkOptions_t.
+     
+     @return bool.
+     */
+    bool isIncluded(const std::string &root, const std::string &path, const walkOptions_t &options);
+}
+
+#endif /* walkUtils_hpp */